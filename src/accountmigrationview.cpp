@@ -30,6 +30,7 @@
 #include <memory> // for std::shared_ptr
 
 // LRC
+#include <globalinstances.h>
 #include <api/newaccountmodel.h>
 
 // Ring Client
@@ -219,17 +220,12 @@ build_migration_view(AccountMigrationView *view)
     }
 
     /* get the current or default profile avatar */
-    auto default_avatar = Interfaces::PixbufManipulator().generateAvatar("", "");
-    auto default_scaled = Interfaces::PixbufManipulator().scaleAndFrame(default_avatar.get(), QSize(AVATAR_WIDTH, AVATAR_HEIGHT));
-    auto photo = default_scaled;
-    auto photostr = (*priv->accountInfo_)->profileInfo.avatar;
-    if (!photostr.empty()) {
-        QByteArray byteArray(photostr.c_str(), photostr.length());
-        QVariant avatar = Interfaces::PixbufManipulator().personPhoto(byteArray);
-        auto pixbuf_photo = Interfaces::PixbufManipulator().scaleAndFrame(avatar.value<std::shared_ptr<GdkPixbuf>>().get(), QSize(AVATAR_WIDTH, AVATAR_HEIGHT));
-        if (avatar.isValid()) {
-            photo = pixbuf_photo;
-        }
+    auto& pixbufManipulator = static_cast<Interfaces::PixbufManipulator&>(GlobalInstances::pixmapManipulator());
+    auto photo = pixbufManipulator.profilePhoto((*priv->accountInfo_)->profileInfo.avatar,
+                                                QSize(AVATAR_WIDTH, AVATAR_HEIGHT));
+    if (!photo) {
+        auto default_avatar = pixbufManipulator.generateAvatar("", "");
+        photo = pixbufManipulator.scaleAndFrame(default_avatar.get(), QSize(AVATAR_WIDTH, AVATAR_HEIGHT));
     }
     gtk_image_set_from_pixbuf(GTK_IMAGE(priv->image_avatar), photo.get());
 
@@ -36,11 +36,18 @@
 
 /* system */
 #include <glib/gi18n.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
 
 /* size of avatar */
 static constexpr int AVATAR_WIDTH  = 150; /* px */
 static constexpr int AVATAR_HEIGHT = 150; /* px */
 
+/* avatars of existing profiles smaller than this, base64 encoded, are not
+ * re-encoded by avatar_manipulation_normalize_account_avatars() */
+static constexpr std::size_t NORMALIZED_AVATAR_MAX_LENGTH = 128 * 1024;
+
 /* size of video widget */
 static constexpr int VIDEO_WIDTH = 150; /* px */
 static constexpr int VIDEO_HEIGHT = 150; /* px */
@@ -230,17 +237,15 @@ set_state(AvatarManipulation *self, AvatarManipulationState state)
         case AVATAR_MANIPULATION_STATE_CURRENT:
         {
             /* get the current or default profile avatar */
-            auto default_avatar = Interfaces::PixbufManipulator().generateAvatar("", "");
-            auto default_scaled = Interfaces::PixbufManipulator().scaleAndFrame(default_avatar.get(), QSize(AVATAR_WIDTH, AVATAR_HEIGHT));
-            auto photo = default_scaled;
+            auto& pixbufManipulator = static_cast<Interfaces::PixbufManipulator&>(GlobalInstances::pixmapManipulator());
+            std::shared_ptr<GdkPixbuf> photo;
             if ((priv->accountInfo_ && (*priv->accountInfo_)) || priv->temporaryAvatar) {
-                auto photostr = priv->temporaryAvatar? priv->temporaryAvatar : (*priv->accountInfo_)->profileInfo.avatar;
-                QByteArray byteArray(photostr.c_str(), photostr.length());
-                QVariant avatar = Interfaces::PixbufManipulator().personPhoto(byteArray);
-                if (avatar.isValid()) {
-                    auto size = QSize(AVATAR_WIDTH, AVATAR_HEIGHT);
-                    photo = Interfaces::PixbufManipulator().scaleAndFrame(avatar.value<std::shared_ptr<GdkPixbuf>>().get(), size);
-                }
+                std::string photostr = priv->temporaryAvatar? priv->temporaryAvatar : (*priv->accountInfo_)->profileInfo.avatar;
+                photo = pixbufManipulator.profilePhoto(photostr, QSize(AVATAR_WIDTH, AVATAR_HEIGHT));
+            }
+            if (!photo) {
+                auto default_avatar = pixbufManipulator.generateAvatar("", "");
+                photo = pixbufManipulator.scaleAndFrame(default_avatar.get(), QSize(AVATAR_WIDTH, AVATAR_HEIGHT));
             }
             gtk_image_set_from_pixbuf(GTK_IMAGE(priv->image_avatar), photo.get());
 
@@ -335,43 +340,27 @@ set_avatar(AvatarManipulation *self)
 {
     AvatarManipulationPrivate *priv = AVATAR_MANIPULATION_GET_PRIVATE(self);
 
-    gchar* png_buffer_signed = nullptr;
-    gsize png_buffer_size;
-    GError* error =  nullptr;
-
     /* get the cropped area */
     GdkPixbuf *selector_pixbuf = cc_crop_area_get_picture(CC_CROP_AREA(priv->crop_area));
 
-    /* scale it */
-    GdkPixbuf* pixbuf_frame_resized = gdk_pixbuf_scale_simple(selector_pixbuf, AVATAR_WIDTH, AVATAR_HEIGHT,
-                                                              GDK_INTERP_HYPER);
-
-    /* save the png in memory */
-    gdk_pixbuf_save_to_buffer(pixbuf_frame_resized, &png_buffer_signed, &png_buffer_size, "png", &error, NULL);
-    if (!png_buffer_signed) {
-        g_warning("(set_avatar) failed to save pixbuffer to png: %s\n", error->message);
-        g_error_free(error);
+    /* scale and encode it */
+    auto avatar = avatar_manipulation_encode(selector_pixbuf);
+    g_object_unref(selector_pixbuf);
+    if (avatar.empty())
         return;
-    }
-
-    /* convert buffer to QByteArray in base 64*/
-    QByteArray png_q_byte_array = QByteArray::fromRawData(png_buffer_signed, png_buffer_size).toBase64();
 
     /* save in profile */
     if (priv->accountInfo_ && (*priv->accountInfo_)) {
         try {
-            (*priv->accountInfo_)->accountModel->setAvatar((*priv->accountInfo_)->id, png_q_byte_array.toStdString());
+            (*priv->accountInfo_)->accountModel->setAvatar((*priv->accountInfo_)->id, avatar);
         } catch (std::out_of_range&) {
             g_warning("Can't set avatar for unknown account");
         }
     } else {
-        priv->temporaryAvatar = g_strdup(png_q_byte_array.toStdString().c_str());
+        g_free(priv->temporaryAvatar);
+        priv->temporaryAvatar = g_strdup(avatar.c_str());
     }
 
-    g_free(png_buffer_signed);
-    g_object_unref(selector_pixbuf);
-    g_object_unref(pixbuf_frame_resized);
-
     set_state(self, AVATAR_MANIPULATION_STATE_CURRENT);
 }
 
@@ -495,3 +484,137 @@ avatar_manipulation_wizard_completed(AvatarManipulation *self)
     if (priv->state == AVATAR_MANIPULATION_STATE_EDIT)
         set_avatar(self);
 }
+
+std::string
+avatar_manipulation_encode(GdkPixbuf *avatar)
+{
+    g_return_val_if_fail(GDK_IS_PIXBUF(avatar), {});
+
+    /* scale it down, respecting the aspect ratio */
+    auto w = gdk_pixbuf_get_width(avatar);
+    auto h = gdk_pixbuf_get_height(avatar);
+    GdkPixbuf *scaled;
+    if (w > AVATAR_WIDTH || h > AVATAR_HEIGHT) {
+        auto scale = std::min((double)AVATAR_WIDTH / w, (double)AVATAR_HEIGHT / h);
+        scaled = gdk_pixbuf_scale_simple(avatar,
+                                         std::max(1, (int)(w * scale)),
+                                         std::max(1, (int)(h * scale)),
+                                         GDK_INTERP_HYPER);
+    } else {
+        scaled = GDK_PIXBUF(g_object_ref(avatar));
+    }
+
+    /* save the png in memory; png is kept since the profiles advertise it */
+    gchar* png_buffer = nullptr;
+    gsize png_buffer_size;
+    GError* error = nullptr;
+    gdk_pixbuf_save_to_buffer(scaled, &png_buffer, &png_buffer_size, "png", &error,
+                              "compression", "9", NULL);
+    g_object_unref(scaled);
+    if (!png_buffer) {
+        g_warning("(avatar_manipulation_encode) failed to save pixbuffer to png: %s\n", error->message);
+        g_error_free(error);
+        return {};
+    }
+
+    auto* base64 = g_base64_encode(reinterpret_cast<const guchar*>(png_buffer), png_buffer_size);
+    std::string encoded = base64;
+    g_free(base64);
+    g_free(png_buffer);
+
+    return encoded;
+}
+
+struct AvatarNormalization
+{
+    std::string accountId;
+    std::string avatar;
+    std::string normalized; ///< empty if avatar is kept
+};
+
+struct NormalizeAvatarsData
+{
+    lrc::api::NewAccountModel* accountModel;
+    std::function<void()> done;
+};
+
+static void
+normalize_avatars(GTask *task,
+                  G_GNUC_UNUSED gpointer source_object,
+                  gpointer task_data,
+                  GCancellable *cancellable)
+{
+    auto avatars = static_cast<std::vector<AvatarNormalization>*>(task_data);
+    for (auto& avatar : *avatars) {
+        if (g_cancellable_is_cancelled(cancellable))
+            break;
+
+        gsize size = 0;
+        auto* data = g_base64_decode(avatar.avatar.c_str(), &size);
+        auto* stream = g_memory_input_stream_new_from_data(data, size, g_free);
+        auto* pixbuf = gdk_pixbuf_new_from_stream(stream, cancellable, nullptr);
+        g_object_unref(stream);
+        if (!pixbuf)
+            continue; // not a base64 image, leave it as is
+
+        auto normalized = avatar_manipulation_encode(pixbuf);
+        g_object_unref(pixbuf);
+        if (!normalized.empty() && normalized.size() < avatar.avatar.size())
+            avatar.normalized = std::move(normalized);
+    }
+
+    g_task_return_boolean(task, TRUE);
+}
+
+static void
+on_avatars_normalized(G_GNUC_UNUSED GObject *source_object, GAsyncResult *result, gpointer user_data)
+{
+    std::unique_ptr<NormalizeAvatarsData> data(static_cast<NormalizeAvatarsData*>(user_data));
+    auto* cancellable = g_task_get_cancellable(G_TASK(result));
+    if (cancellable && g_cancellable_is_cancelled(cancellable))
+        return;
+
+    auto avatars = static_cast<std::vector<AvatarNormalization>*>(g_task_get_task_data(G_TASK(result)));
+    for (const auto& avatar : *avatars) {
+        if (avatar.normalized.empty())
+            continue;
+        try {
+            // the avatar may have been changed in the meantime
+            const auto& accountInfo = data->accountModel->getAccountInfo(avatar.accountId);
+            if (accountInfo.profileInfo.avatar == avatar.avatar)
+                data->accountModel->setAvatar(avatar.accountId, avatar.normalized);
+        } catch (std::out_of_range&) {
+            // the account was removed
+        }
+    }
+
+    if (data->done)
+        data->done();
+}
+
+void
+avatar_manipulation_normalize_account_avatars(lrc::api::NewAccountModel& accountModel,
+                                              GCancellable *cancellable,
+                                              std::function<void()> done)
+{
+    auto* avatars = new std::vector<AvatarNormalization>();
+    for (const auto& accountId : accountModel.getAccountList()) {
+        const auto& avatar = accountModel.getAccountInfo(accountId).profileInfo.avatar;
+        if (avatar.size() > NORMALIZED_AVATAR_MAX_LENGTH)
+            avatars->push_back({accountId, avatar, {}});
+    }
+    if (avatars->empty()) {
+        delete avatars;
+        if (done)
+            done();
+        return;
+    }
+
+    auto* task = g_task_new(nullptr, cancellable, on_avatars_normalized,
+                            new NormalizeAvatarsData{&accountModel, std::move(done)});
+    g_task_set_task_data(task, avatars, [] (gpointer avatars) {
+        delete static_cast<std::vector<AvatarNormalization>*>(avatars);
+    });
+    g_task_run_in_thread(task, normalize_avatars);
+    g_object_unref(task);
+}
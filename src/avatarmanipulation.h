@@ -24,6 +24,9 @@
 #include <api/account.h>
 #include <api/profile.h>
 
+#include <functional>
+#include <string>
+
 #include "accountinfopointer.h"
 
 G_BEGIN_DECLS
@@ -67,4 +70,19 @@ gchar*     avatar_manipulation_get_temporary   (AvatarManipulation *view);
 
 G_END_DECLS
 
+/* C++ helpers, declared outside of G_BEGIN_DECLS for their C++ types */
+
+/* Encodes an avatar as stored in profiles: a base64 png no larger than the
+ * avatar size. Returns an empty string on failure. Can be called from any
+ * thread. */
+std::string avatar_manipulation_encode         (GdkPixbuf *avatar);
+
+/* Re-encodes in the background the avatars of the accounts which are larger
+ * than the avatar size, e.g. stored by older versions or imported. done is
+ * called on the main thread once the profiles are updated, unless cancellable
+ * is cancelled. */
+void       avatar_manipulation_normalize_account_avatars(lrc::api::NewAccountModel& accountModel,
+                                                         GCancellable *cancellable,
+                                                         std::function<void()> done);
+
 #endif /* _AVATARMANIPULATION_H */
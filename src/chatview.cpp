@@ -301,6 +301,19 @@ webkit_chat_container_script_dialog(GtkWidget* webview, gchar *interaction, Chat
         } catch (...) {
             g_warning("delete interaction failed: can't find %s", order.substr(std::string("RETRY_INTERACTION:").size()).c_str());
         }
+    } else if (order.find("LOAD_HISTORY:") == 0) {
+        try {
+            auto before = std::stoull(order.substr(std::string("LOAD_HISTORY:").size()));
+            if (!priv->conversation_) return;
+            webkit_chat_container_print_history_page(
+                WEBKIT_CHAT_CONTAINER(priv->webkit_chat_container),
+                *(*priv->accountInfo_)->conversationModel,
+                priv->conversation_->interactions,
+                before
+            );
+        } catch (...) {
+            g_warning("load history failed: invalid cursor %s", order.substr(std::string("LOAD_HISTORY:").size()).c_str());
+        }
     }
 }
 
@@ -453,6 +466,10 @@ webkit_chat_container_ready(ChatView* self)
     print_text_recording(self);
     load_participants_images(self);
 
+    /* the container is ready again after its web process crashed */
+    QObject::disconnect(priv->update_interaction_connection);
+    QObject::disconnect(priv->interaction_removed);
+
     priv->new_interaction_connection = QObject::connect(
     &*(*priv->accountInfo_)->conversationModel, &lrc::api::ConversationModel::newInteraction,
     [self, priv](const std::string& uid, uint64_t interactionId, lrc::api::interaction::Info interaction) {
@@ -651,12 +668,12 @@ chat_view_update_temporary(ChatView* self)
     update_chatview_frame(self);
 }
 
-lrc::api::conversation::Info
+const lrc::api::conversation::Info*
 chat_view_get_conversation(ChatView *self)
 {
-    g_return_val_if_fail(IS_CHAT_VIEW(self), lrc::api::conversation::Info());
+    g_return_val_if_fail(IS_CHAT_VIEW(self), nullptr);
     auto priv = CHAT_VIEW_GET_PRIVATE(self);
-    return *priv->conversation_;
+    return priv->conversation_;
 }
 
 void
@@ -56,7 +56,7 @@ GType          chat_view_get_type   (void) G_GNUC_CONST;
 GtkWidget     *chat_view_new        (WebKitChatContainer* view,
                                      AccountInfoPointer const & accountInfo,
                                      lrc::api::conversation::Info* conversation);
-lrc::api::conversation::Info chat_view_get_conversation(ChatView*);
+const lrc::api::conversation::Info* chat_view_get_conversation(ChatView*);
 void chat_view_update_temporary(ChatView*);
 void chat_view_set_header_visible(ChatView*, gboolean);
 
@@ -26,6 +26,11 @@
 #include <iomanip> // for std::put_time
 #include <string>
 #include <sstream>
+#include <ctime>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <vector>
 
 // GTK+ related
 #include <QSize>
@@ -57,12 +62,45 @@ struct _ConversationsViewClass
 
 typedef struct _ConversationsViewPrivate ConversationsViewPrivate;
 
+/**
+ * What the cell renderers draw for a conversation, computed when the row
+ * changes so drawing the list is a matter of lookups.
+ */
+struct ConversationRow
+{
+    GtkTreeIter iter;
+    unsigned generation = 0; ///< last sync_model() which listed the conversation
+
+    std::string uid;
+    std::vector<std::string> participants; ///< the photo is drawn from the first one
+    std::string markup; ///< name and last interaction
+    bool banned = false;
+    bool present = false;
+    unsigned unreadMessages = 0;
+    std::string callId; ///< call or conference in progress
+    std::time_t lastTimestamp = 0; ///< of the last interaction, 0 if none
+
+    std::shared_ptr<cairo_surface_t> photo; ///< drawn on first render
+    std::string time; ///< call status or time of the last interaction
+    std::time_t timeExpiry = 0; ///< when time must be computed again
+    unsigned callGeneration = 0; ///< callGeneration_ when time was computed
+};
+
 struct _ConversationsViewPrivate
 {
     AccountInfoPointer const *accountInfo_;
 
     GtkWidget* popupMenu_;
 
+    /* conversation uid -> row, so a conversation update does not have to
+     * scan the whole list. GtkListStore iters stay valid until their row is
+     * removed, whatever is inserted or reordered around them. */
+    std::unordered_map<std::string, ConversationRow>* rows_;
+    unsigned generation_;
+    /* incremented when a call status changes, so the rows showing a call
+     * status compute it again */
+    unsigned callGeneration_;
+
     QMetaObject::Connection selection_updated;
     QMetaObject::Connection layout_changed;
     QMetaObject::Connection modelSortedConnection_;
@@ -75,6 +113,33 @@ G_DEFINE_TYPE_WITH_PRIVATE(ConversationsView, conversations_view, GTK_TYPE_TREE_
 
 #define CONVERSATIONS_VIEW_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), CONVERSATIONS_VIEW_TYPE, ConversationsViewPrivate))
 
+static ConversationRow*
+get_row(GtkTreeModel *model, GtkTreeIter *iter)
+{
+    ConversationRow *row = nullptr;
+    gtk_tree_model_get(model, iter, 1 /* col# */, &row /* data */, -1);
+    return row;
+}
+
+/**
+ * Draw the photo of the conversation again, e.g. once it is decoded.
+ */
+static void
+refresh_photo(ConversationsView *self, const std::string& uid)
+{
+    auto priv = CONVERSATIONS_VIEW_GET_PRIVATE(self);
+    auto model = gtk_tree_view_get_model(GTK_TREE_VIEW(self));
+    auto it = priv->rows_->find(uid);
+    if (!model || it == priv->rows_->end())
+        return;
+
+    auto& row = it->second;
+    row.photo.reset();
+    auto path = gtk_tree_model_get_path(model, &row.iter);
+    gtk_tree_model_row_changed(model, path, &row.iter);
+    gtk_tree_path_free(path);
+}
+
 static void
 render_contact_photo(G_GNUC_UNUSED GtkTreeViewColumn *tree_column,
                      GtkCellRenderer *cell,
@@ -82,39 +147,50 @@ render_contact_photo(G_GNUC_UNUSED GtkTreeViewColumn *tree_column,
                      GtkTreeIter *iter,
                      gpointer self)
 {
-    // Get active conversation
-    auto path = gtk_tree_model_get_path(model, iter);
-    auto row = std::atoi(gtk_tree_path_to_string(path));
-    if (row == -1) return;
     auto priv = CONVERSATIONS_VIEW_GET_PRIVATE(self);
     if (!priv) return;
-    try
-    {
+    auto row = get_row(model, iter);
+    if (!row) return;
+
+    if (!row->photo) {
+        // only what the photo is drawn from is needed, the row has it
+        lrc::api::conversation::Info conversationInfo;
+        conversationInfo.uid = row->uid;
+        conversationInfo.participants = row->participants;
+        conversationInfo.unreadMessages = row->unreadMessages;
+
+        // the photo may be decoded in the background, then the row is
+        // redrawn if the view still exists
+        std::shared_ptr<GWeakRef> weakSelf(new GWeakRef, [] (GWeakRef* ref) {
+            g_weak_ref_clear(ref);
+            delete ref;
+        });
+        g_weak_ref_init(weakSelf.get(), self);
+        auto uid = row->uid;
+        auto& pixbufManipulator = static_cast<Interfaces::PixbufManipulator&>(GlobalInstances::pixmapManipulator());
         // Draw first contact.
         // NOTE: We just draw the first contact, must change this for conferences when they will have their own object
-        auto conversationInfo = (*priv->accountInfo_)->conversationModel->filteredConversation(row);
-        auto contactInfo = (*priv->accountInfo_)->contactModel->getContact(conversationInfo.participants.front());
-        std::shared_ptr<GdkPixbuf> image;
-        auto var_photo = GlobalInstances::pixmapManipulator().conversationPhoto(
+        row->photo = pixbufManipulator.conversationPhotoAsync(
             conversationInfo,
             **(priv->accountInfo_),
             QSize(50, 50),
-            contactInfo.isPresent
+            row->present,
+            [weakSelf, uid] () {
+                if (auto view = g_weak_ref_get(weakSelf.get())) {
+                    refresh_photo(CONVERSATIONS_VIEW(view), uid);
+                    g_object_unref(view);
+                }
+            }
         );
-        image = var_photo.value<std::shared_ptr<GdkPixbuf>>();
+    }
 
-        // set the width of the cell rendered to the width of the photo
-        // so that the other renderers are shifted to the right
-        g_object_set(G_OBJECT(cell), "width", 50, NULL);
-        g_object_set(G_OBJECT(cell), "pixbuf", image.get(), NULL);
+    // set the width of the cell rendered to the width of the photo
+    // so that the other renderers are shifted to the right
+    g_object_set(G_OBJECT(cell), "width", 50, NULL);
+    g_object_set(G_OBJECT(cell), "surface", row->photo.get(), NULL);
 
-        // Banned contacts should be displayed with grey bg
-        g_object_set(G_OBJECT(cell), "cell-background", contactInfo.isBanned ? "#BDBDBD" : NULL, NULL);
-    }
-    catch (const std::exception&)
-    {
-        g_warning("Can't get conversation at row %i", row);
-    }
+    // Banned contacts should be displayed with grey bg
+    g_object_set(G_OBJECT(cell), "cell-background", row->banned ? "#BDBDBD" : NULL, NULL);
 }
 
 static void
@@ -122,194 +198,251 @@ render_name_and_last_interaction(G_GNUC_UNUSED GtkTreeViewColumn *tree_column,
                                  GtkCellRenderer *cell,
                                  GtkTreeModel *model,
                                  GtkTreeIter *iter,
-                                 GtkTreeView *treeview)
+                                 G_GNUC_UNUSED GtkTreeView *treeview)
 {
-    gchar *alias;
-    gchar *registeredName;
-    gchar *lastInteraction;
-    gchar *text;
-    gchar *uid;
-    gchar *uri;
+    auto row = get_row(model, iter);
+    if (!row) return;
+
+    // Banned contacts should be displayed with grey bg
+    g_object_set(G_OBJECT(cell), "cell-background", row->banned ? "#BDBDBD" : NULL, NULL);
 
-    // Get active conversation
-    auto path = gtk_tree_model_get_path(model, iter);
-    auto row = std::atoi(gtk_tree_path_to_string(path));
-    if (row == -1) return;
+    g_object_set(G_OBJECT(cell), "markup", row->markup.c_str(), NULL);
+}
+
+/**
+ * Get the call status or the time of the last interaction to display for the
+ * row, computing it again when a call status changed or when a time of the
+ * day has to become a date.
+ */
+static const std::string&
+get_time_markup(ConversationsViewPrivate *priv, ConversationRow& row)
+{
+    auto now = std::time(nullptr);
+    if (row.callGeneration == priv->callGeneration_ && now < row.timeExpiry)
+        return row.time;
+
+    row.callGeneration = priv->callGeneration_;
+    row.timeExpiry = std::numeric_limits<std::time_t>::max();
+    row.time.clear();
 
+    if (!row.callId.empty()) {
+        try {
+            const auto& call = (*priv->accountInfo_)->callModel->getCall(row.callId);
+            if (call.status != lrc::api::call::Status::ENDED) {
+                row.time = lrc::api::call::to_string(call.status);
+                return row.time;
+            }
+        } catch (const std::exception&) {
+            g_warning("Can't get call %s", row.callId.c_str());
+        }
+    }
+
+    if (row.lastTimestamp) {
+        // the time is shown for the last 24 hours, then the date
+        static constexpr std::time_t DAY = 24 * 60 * 60;
+        auto recent = now - row.lastTimestamp < DAY;
+        if (recent)
+            row.timeExpiry = row.lastTimestamp + DAY;
+
+        std::stringstream timestamp;
+        timestamp << std::put_time(std::localtime(&row.lastTimestamp), recent ? "%R" : "%x");
+        gchar* text = g_markup_printf_escaped("<span size=\"smaller\" color=\"#666\">%s</span>", timestamp.str().c_str());
+        row.time = text;
+        g_free(text);
+    }
+
+    return row.time;
+}
+
+static void
+render_time(G_GNUC_UNUSED GtkTreeViewColumn *tree_column,
+            GtkCellRenderer *cell,
+            GtkTreeModel *model,
+            GtkTreeIter *iter,
+            GtkTreeView *treeview)
+{
+    g_return_if_fail(IS_CONVERSATIONS_VIEW(treeview));
     auto priv = CONVERSATIONS_VIEW_GET_PRIVATE(treeview);
-    if (!priv) return;
+    g_return_if_fail(priv);
+    auto row = get_row(model, iter);
+    g_return_if_fail(row);
+
+    // Banned contacts should be displayed with grey bg
+    g_object_set(G_OBJECT(cell), "cell-background", row->banned ? "#BDBDBD" : NULL, NULL);
+
+    g_object_set(G_OBJECT(cell), "markup", get_time_markup(priv, *row).c_str(), NULL);
+}
+
+/**
+ * Get the row showing the conversation uid.
+ * @return FALSE if the conversation is not in the list
+ */
+static gboolean
+get_conversation_iter(ConversationsView *self, const std::string& uid, GtkTreeIter *iter)
+{
+    auto priv = CONVERSATIONS_VIEW_GET_PRIVATE(self);
+    auto it = priv->rows_->find(uid);
+    if (it == priv->rows_->end())
+        return FALSE;
 
-    auto conversation = (*priv->accountInfo_)->conversationModel->filteredConversation(row);
-    auto contactUri = conversation.participants.front();
-    auto contactInfo = (*priv->accountInfo_)->contactModel->getContact(contactUri);
+    *iter = it->second.iter;
+    return TRUE;
+}
 
-    gtk_tree_model_get (model, iter,
-                        0 /* col# */, &uid /* data */,
-                        1 /* col# */, &alias /* data */,
-                        2 /* col# */, &uri /* data */,
-                        3 /* col# */, &registeredName /* data */,
-                        5 /* col# */, &lastInteraction /* data */,
-                        -1);
+static std::string
+name_and_last_interaction_markup(const lrc::api::contact::Info& contactInfo,
+                                 const std::string& lastInteraction)
+{
+    auto alias = contactInfo.profileInfo.alias;
+    alias.erase(std::remove(alias.begin(), alias.end(), '\r'), alias.end());
+    const auto& bestId = contactInfo.registeredName.empty() ?
+        contactInfo.profileInfo.uri : contactInfo.registeredName;
 
-    auto bestId = std::string(registeredName).empty() ? uri: registeredName;
+    gchar *text;
     if (contactInfo.isBanned) {
         // Contact is banned, display it clearly
         text = g_markup_printf_escaped(
             "<span font_weight=\"bold\">%s</span>\n<span size=\"smaller\" font_weight=\"bold\">Banned contact</span>",
-            bestId
+            bestId.c_str()
         );
-    } else if (std::string(alias).empty()) {
+    } else if (alias.empty()) {
         // If no alias to show, use the best id
         text = g_markup_printf_escaped(
             "<span font_weight=\"bold\">%s</span>\n<span size=\"smaller\" color=\"#666\">%s</span>",
-            bestId,
-            lastInteraction
+            bestId.c_str(),
+            lastInteraction.c_str()
         );
-    } else if (std::string(alias) == std::string(bestId)) {
+    } else if (alias == bestId) {
         // If the alias and the best id are identical, show only the alias
         text = g_markup_printf_escaped(
             "<span font_weight=\"bold\">%s</span>\n<span size=\"smaller\" color=\"#666\">%s</span>",
-            alias,
-            lastInteraction
+            alias.c_str(),
+            lastInteraction.c_str()
         );
     } else {
         // If the alias is not empty and not equals to the best id, show both the alias and the best id
         text = g_markup_printf_escaped(
             "<span font_weight=\"bold\">%s</span>\n<span size=\"smaller\" color=\"#666\">%s</span>\n<span size=\"smaller\" color=\"#666\">%s</span>",
-            alias,
-            bestId,
-            lastInteraction
+            alias.c_str(),
+            bestId.c_str(),
+            lastInteraction.c_str()
         );
     }
 
-    // Banned contacts should be displayed with grey bg
-    g_object_set(G_OBJECT(cell), "cell-background", contactInfo.isBanned ? "#BDBDBD" : NULL, NULL);
-
-    g_object_set(G_OBJECT(cell), "markup", text, NULL);
+    std::string markup = text;
     g_free(text);
-    g_free(uid);
-    g_free(uri);
-    g_free(alias);
-    g_free(registeredName);
+    return markup;
 }
 
+/**
+ * Compute what the row displays for a conversation. Nothing is done when the
+ * displayed values did not change, so the row is not redrawn.
+ * @param refreshPhoto, draw the photo again even if the presence and the
+ * number of unread messages did not change, e.g. the avatar was updated
+ */
 static void
-render_time(G_GNUC_UNUSED GtkTreeViewColumn *tree_column,
-            GtkCellRenderer *cell,
-            GtkTreeModel *model,
-            GtkTreeIter *iter,
-            G_GNUC_UNUSED GtkTreeView *treeview)
+set_conversation_row(GtkListStore *store,
+                     ConversationRow& row,
+                     gboolean inserted,
+                     gboolean refreshPhoto,
+                     const lrc::api::conversation::Info& conversation,
+                     const lrc::api::contact::Info& contactInfo)
 {
-    g_return_if_fail(IS_CONVERSATIONS_VIEW(treeview));
-    auto priv = CONVERSATIONS_VIEW_GET_PRIVATE(treeview);
-    g_return_if_fail(priv);
-
-    // Get active conversation
-    auto path = gtk_tree_model_get_path(model, iter);
-    auto row = std::atoi(gtk_tree_path_to_string(path));
-    g_return_if_fail(row != -1);
-
-    try {
-        auto conversation = (*priv->accountInfo_)->conversationModel->filteredConversation(row);
-        auto contactUri = conversation.participants.front();
-        auto& contactInfo = (*priv->accountInfo_)->contactModel->getContact(contactUri);
-
-        // Banned contacts should be displayed with grey bg
-        g_object_set(G_OBJECT(cell), "cell-background", contactInfo.isBanned ? "#BDBDBD" : NULL, NULL);
-
-        auto callId = conversation.confId.empty() ? conversation.callId : conversation.confId;
-        if (!callId.empty()) {
-            auto call = (*priv->accountInfo_)->callModel->getCall(callId);
-            if (call.status != lrc::api::call::Status::ENDED) {
-                g_object_set(G_OBJECT(cell), "markup", lrc::api::call::to_string(call.status).c_str(), NULL);
-                return;
-            }
-        }
-
-        auto& interactions = conversation.interactions;
-        auto lastUid = conversation.lastMessageUid;
-
-        if (!interactions.empty() && interactions.find(lastUid) != interactions.end()) {
-            std::time_t lastTimestamp = interactions[lastUid].timestamp;
-            std::chrono::time_point<std::chrono::system_clock> lastTs = std::chrono::system_clock::from_time_t(lastTimestamp);
-            std::chrono::time_point<std::chrono::system_clock> now = std::chrono::system_clock::now();
-            std::chrono::hours diff = std::chrono::duration_cast<std::chrono::hours>(now - lastTs);
-
-            std::stringstream timestamp;
-            timestamp << std::put_time(std::localtime(&lastTimestamp), diff.count() < 24 ? "%R" : "%x");
-            gchar* text = g_markup_printf_escaped("<span size=\"smaller\" color=\"#666\">%s</span>", timestamp.str().c_str());
-            g_object_set(G_OBJECT(cell), "markup", text, NULL);
-
-            g_free(text);
-            return;
-        }
-    } catch (const std::exception&) {
-        g_warning("Can't get conversation at row %i", row);
+    std::string lastMessage;
+    std::time_t lastTimestamp = 0;
+    auto lastInteraction = conversation.interactions.find(conversation.lastMessageUid);
+    if (lastInteraction != conversation.interactions.end()) {
+        lastMessage = lastInteraction->second.body;
+        std::replace(lastMessage.begin(), lastMessage.end(), '\n', ' ');
+        lastTimestamp = lastInteraction->second.timestamp;
+    }
+    auto markup = name_and_last_interaction_markup(contactInfo, lastMessage);
+    const auto& callId = conversation.confId.empty() ? conversation.callId : conversation.confId;
+
+    auto photoChanged = refreshPhoto
+        || conversation.participants != row.participants
+        || contactInfo.isPresent != row.present
+        || conversation.unreadMessages != row.unreadMessages;
+    auto timeChanged = lastTimestamp != row.lastTimestamp || callId != row.callId;
+    if (!inserted && !photoChanged && !timeChanged
+        && contactInfo.isBanned == row.banned && markup == row.markup)
+        return;
+
+    row.uid = conversation.uid;
+    row.participants = conversation.participants;
+    row.markup = std::move(markup);
+    row.banned = contactInfo.isBanned;
+    row.present = contactInfo.isPresent;
+    row.unreadMessages = conversation.unreadMessages;
+    row.callId = callId;
+    row.lastTimestamp = lastTimestamp;
+    if (photoChanged)
+        row.photo.reset();
+    if (timeChanged)
+        row.timeExpiry = 0;
+
+    if (inserted) {
+        gtk_list_store_insert_with_values (store, &row.iter, -1,
+                                           0 /* col # */ , conversation.uid.c_str() /* celldata */,
+                                           1 /* col # */ , &row /* celldata */,
+                                           -1 /* end */);
+    } else {
+        auto path = gtk_tree_model_get_path(GTK_TREE_MODEL(store), &row.iter);
+        gtk_tree_model_row_changed(GTK_TREE_MODEL(store), path, &row.iter);
+        gtk_tree_path_free(path);
     }
-
-    g_object_set(G_OBJECT(cell), "markup", "", NULL);
 }
 
+static void sync_model(ConversationsView *self);
+
 void
 update_conversation(ConversationsView *self, const std::string& uid) {
     auto priv = CONVERSATIONS_VIEW_GET_PRIVATE(self);
     auto model = gtk_tree_view_get_model (GTK_TREE_VIEW(self));
 
-    auto idx = 0;
-    auto iterIsCorrect = true;
-    GtkTreeIter iter;
+    auto it = priv->rows_->find(uid);
+    if (it == priv->rows_->end())
+        return;
 
-    while(iterIsCorrect) {
-        iterIsCorrect = gtk_tree_model_iter_nth_child (model, &iter, nullptr, idx);
-        if (!iterIsCorrect)
-            break;
-        gchar *ringId;
-        gtk_tree_model_get (model, &iter,
-                            0 /* col# */, &ringId /* data */,
-                            -1);
-        if(std::string(ringId) == uid) {
-            // Get informations
-            auto conversation = (*priv->accountInfo_)->conversationModel->filteredConversation(idx);
-            auto contactUri = conversation.participants.front();
-            auto contactInfo = (*priv->accountInfo_)->contactModel->getContact(contactUri);
-            auto lastMessage = conversation.interactions.empty() ? "" :
-                conversation.interactions.at(conversation.lastMessageUid).body;
-            std::replace(lastMessage.begin(), lastMessage.end(), '\n', ' ');
-            auto alias = contactInfo.profileInfo.alias;
-            alias.erase(std::remove(alias.begin(), alias.end(), '\r'), alias.end());
-            // Update iter
-            gtk_list_store_set (GTK_LIST_STORE(model), &iter,
-                                0 /* col # */ , conversation.uid.c_str() /* celldata */,
-                                1 /* col # */ , alias.c_str() /* celldata */,
-                                2 /* col # */ , contactInfo.profileInfo.uri.c_str() /* celldata */,
-                                3 /* col # */ , contactInfo.registeredName.c_str() /* celldata */,
-                                4 /* col # */ , contactInfo.profileInfo.avatar.c_str() /* celldata */,
-                                5 /* col # */ , lastMessage.c_str() /* celldata */,
-                                -1 /* end */);
-            g_free(ringId);
+    auto path = gtk_tree_model_get_path(model, &it->second.iter);
+    auto idx = gtk_tree_path_get_indices(path)[0];
+    gtk_tree_path_free(path);
+
+    try {
+        const auto& conversation = (*priv->accountInfo_)->conversationModel->filteredConversation(idx);
+        if (conversation.uid != uid) {
+            // the model was sorted or filtered again since the last sync
+            sync_model(self);
+            refresh_photo(self, uid);
             return;
         }
-        g_free(ringId);
-        idx++;
+        const auto& contactInfo = (*priv->accountInfo_)->contactModel->getContact(conversation.participants.front());
+        set_conversation_row(GTK_LIST_STORE(model), it->second, FALSE, TRUE, conversation, contactInfo);
+    } catch (const std::out_of_range&) {
+        // ContactModel::getContact() exception
     }
 }
 
-static GtkTreeModel*
-create_and_fill_model(ConversationsView *self)
+/**
+ * Bring the rows in line with the filtered conversations of the model: rows
+ * of conversations which were filtered out are removed, new conversations
+ * are appended, changed rows are updated and the store is then reordered
+ * once, so the view only redraws what changed.
+ */
+static void
+sync_model(ConversationsView *self)
 {
     auto priv = CONVERSATIONS_VIEW_GET_PRIVATE(self);
-    auto store = gtk_list_store_new (6 /* # of cols */ ,
-                                     G_TYPE_STRING,
-                                     G_TYPE_STRING,
-                                     G_TYPE_STRING,
-                                     G_TYPE_STRING,
-                                     G_TYPE_STRING,
-                                     G_TYPE_STRING,
-                                     G_TYPE_UINT);
-    if(!priv) GTK_TREE_MODEL (store);
-    GtkTreeIter iter;
+    auto store = GTK_LIST_STORE(gtk_tree_view_get_model(GTK_TREE_VIEW(self)));
+    auto& rows = *priv->rows_;
+    auto generation = ++priv->generation_;
+
+    const auto& conversations = (*priv->accountInfo_)->conversationModel->allFilteredConversations();
+    // rows in the order of the filtered conversations
+    std::vector<ConversationRow*> order;
+    order.reserve(conversations.size());
 
-    for (auto conversation : (*priv->accountInfo_)->conversationModel->allFilteredConversations()) {
+    for (const auto& conversation : conversations) {
         if (conversation.participants.empty()) {
             g_debug("Found conversation with empty list of participants - most likely the result of earlier bug.");
             break;
@@ -317,27 +450,43 @@ create_and_fill_model(ConversationsView *self)
 
         auto contactUri = conversation.participants.front();
         try {
-            auto contactInfo = (*priv->accountInfo_)->contactModel->getContact(contactUri);
-            auto lastMessage = conversation.interactions.empty() ? "" :
-                conversation.interactions.at(conversation.lastMessageUid).body;
-            std::replace(lastMessage.begin(), lastMessage.end(), '\n', ' ');
-            gtk_list_store_append (store, &iter);
-            auto alias = contactInfo.profileInfo.alias;
-            alias.erase(std::remove(alias.begin(), alias.end(), '\r'), alias.end());
-            gtk_list_store_set (store, &iter,
-                                0 /* col # */ , conversation.uid.c_str() /* celldata */,
-                                1 /* col # */ , alias.c_str() /* celldata */,
-                                2 /* col # */ , contactInfo.profileInfo.uri.c_str() /* celldata */,
-                                3 /* col # */ , contactInfo.registeredName.c_str() /* celldata */,
-                                4 /* col # */ , contactInfo.profileInfo.avatar.c_str() /* celldata */,
-                                5 /* col # */ , lastMessage.c_str() /* celldata */,
-                                -1 /* end */);
+            const auto& contactInfo = (*priv->accountInfo_)->contactModel->getContact(contactUri);
+            auto it = rows.find(conversation.uid);
+            auto inserted = it == rows.end();
+            if (inserted)
+                it = rows.emplace(conversation.uid, ConversationRow()).first;
+            else if (it->second.generation == generation)
+                continue; // already listed
+            it->second.generation = generation;
+            set_conversation_row(store, it->second, inserted, FALSE, conversation, contactInfo);
+            order.push_back(&it->second);
         } catch (const std::out_of_range&) {
             // ContactModel::getContact() exception
         }
     }
 
-    return GTK_TREE_MODEL (store);
+    for (auto it = rows.begin(); it != rows.end();) {
+        if (it->second.generation != generation) {
+            gtk_list_store_remove(store, &it->second.iter);
+            it = rows.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // new_order[new position] = old position
+    std::vector<gint> newOrder;
+    newOrder.reserve(order.size());
+    auto sorted = true;
+    for (auto* row : order) {
+        auto path = gtk_tree_model_get_path(GTK_TREE_MODEL(store), &row->iter);
+        auto position = gtk_tree_path_get_indices(path)[0];
+        gtk_tree_path_free(path);
+        sorted = sorted && position == static_cast<gint>(newOrder.size());
+        newOrder.push_back(position);
+    }
+    if (!sorted)
+        gtk_list_store_reorder(store, newOrder.data());
 }
 
 static void
@@ -346,11 +495,10 @@ call_conversation(GtkTreeView *self,
                   G_GNUC_UNUSED GtkTreeViewColumn *column,
                   G_GNUC_UNUSED gpointer user_data)
 {
-    auto row = std::atoi(gtk_tree_path_to_string(path));
-    if (row == -1) return;
+    auto row = gtk_tree_path_get_indices(path)[0];
     auto priv = CONVERSATIONS_VIEW_GET_PRIVATE(self);
     if (!priv) return;
-    auto conversation = (*priv->accountInfo_)->conversationModel->filteredConversation(row);
+    const auto& conversation = (*priv->accountInfo_)->conversationModel->filteredConversation(row);
     (*priv->accountInfo_)->conversationModel->placeCall(conversation.uid);
 }
 
@@ -391,9 +539,10 @@ select_conversation(GtkTreeSelection *selection, ConversationsView *self)
 }
 
 static void
-conversations_view_init(G_GNUC_UNUSED ConversationsView *self)
+conversations_view_init(ConversationsView *self)
 {
-    // Nothing to do
+    auto priv = CONVERSATIONS_VIEW_GET_PRIVATE(self);
+    priv->rows_ = new std::unordered_map<std::string, ConversationRow>();
 }
 
 static void
@@ -559,9 +708,13 @@ build_conversations_view(ConversationsView *self)
     auto priv = CONVERSATIONS_VIEW_GET_PRIVATE(self);
     gtk_tree_view_set_headers_visible(GTK_TREE_VIEW(self), FALSE);
 
-    auto model = create_and_fill_model(self);
+    auto store = gtk_list_store_new (2 /* # of cols */ ,
+                                     G_TYPE_STRING,
+                                     G_TYPE_POINTER);
     gtk_tree_view_set_model(GTK_TREE_VIEW(self),
-                            GTK_TREE_MODEL(model));
+                            GTK_TREE_MODEL(store));
+    g_object_unref(store);
+    sync_model(self);
 
     // ringId method column
     auto area = gtk_cell_area_box_new();
@@ -610,10 +763,7 @@ build_conversations_view(ConversationsView *self)
     &*(*priv->accountInfo_)->conversationModel,
     &lrc::api::ConversationModel::modelSorted,
     [self] () {
-        auto model = create_and_fill_model(self);
-
-        gtk_tree_view_set_model(GTK_TREE_VIEW(self),
-                                GTK_TREE_MODEL(model));
+        sync_model(self);
     });
     priv->conversationUpdatedConnection_ = QObject::connect(
     &*(*priv->accountInfo_)->conversationModel,
@@ -626,31 +776,16 @@ build_conversations_view(ConversationsView *self)
     &*(*priv->accountInfo_)->conversationModel,
     &lrc::api::ConversationModel::filterChanged,
     [self] () {
-        auto model = create_and_fill_model(self);
-
-        gtk_tree_view_set_model(GTK_TREE_VIEW(self),
-                                GTK_TREE_MODEL(model));
+        sync_model(self);
     });
 
     priv->callChangedConnection_ = QObject::connect(
     &*(*priv->accountInfo_)->callModel,
     &lrc::api::NewCallModel::callStatusChanged,
     [self, priv] (const std::string&) {
-        // retrieve currently selected conversation
-        GtkTreeIter iter;
-        GtkTreeModel *model = nullptr;
-        gchar *conversationUid = nullptr;
-
-        auto selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(self));
-        if (!gtk_tree_selection_get_selected(selection, &model, &iter)) return;
-        gtk_tree_model_get(model, &iter, 0, &conversationUid, -1);
-
-        // create updated model
-        auto new_model = create_and_fill_model(self);
-        gtk_tree_view_set_model(GTK_TREE_VIEW(self), GTK_TREE_MODEL(new_model));
-
-        // make sure conversation remains selected
-        conversations_view_select_conversation(self, conversationUid);
+        // the call status is shown in place of the time of the last interaction
+        ++priv->callGeneration_;
+        gtk_widget_queue_draw(GTK_WIDGET(self));
     });
 
     gtk_widget_show_all(GTK_WIDGET(self));
@@ -703,6 +838,10 @@ conversations_view_dispose(GObject *object)
 static void
 conversations_view_finalize(GObject *object)
 {
+    auto priv = CONVERSATIONS_VIEW_GET_PRIVATE(object);
+
+    delete priv->rows_;
+
     G_OBJECT_CLASS(conversations_view_parent_class)->finalize(object);
 }
 
@@ -738,27 +877,11 @@ conversations_view_new(AccountInfoPointer const & accountInfo)
 void
 conversations_view_select_conversation(ConversationsView *self, const std::string& uid)
 {
-    auto idx = 0;
-    auto model = gtk_tree_view_get_model (GTK_TREE_VIEW(self));
-    auto iterIsCorrect = true;
     GtkTreeIter iter;
+    if (!get_conversation_iter(self, uid, &iter))
+        return;
 
-    while(iterIsCorrect) {
-        iterIsCorrect = gtk_tree_model_iter_nth_child (model, &iter, nullptr, idx);
-        if (!iterIsCorrect)
-            break;
-        gchar *ringId;
-        gtk_tree_model_get (model, &iter,
-                            0 /* col# */, &ringId /* data */,
-                            -1);
-        if(std::string(ringId) == uid) {
-            auto selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(self));
-            gtk_tree_selection_select_iter(selection, &iter);
-            refresh_popup_menu(self);
-            g_free(ringId);
-            return;
-        }
-        g_free(ringId);
-        idx++;
-    }
+    auto selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(self));
+    gtk_tree_selection_select_iter(selection, &iter);
+    refresh_popup_menu(self);
 }
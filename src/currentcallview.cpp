@@ -135,6 +135,17 @@ map_boolean_to_orientation(GValue* value, GVariant* variant, G_GNUC_UNUSED gpoin
     return FALSE;
 }
 
+/**
+ * Text of a frame latency percentile, without the unit.
+ */
+static std::string
+latency_to_string(guint latency_ms)
+{
+    if (latency_ms == VIDEO_WIDGET_LATENCY_UNBOUNDED)
+        return ">" + std::to_string(VIDEO_WIDGET_LATENCY_MAX_MS);
+    return std::to_string(latency_ms);
+}
+
 static ClutterTransition*
 create_fade_out_transition()
 {
@@ -747,7 +758,7 @@ void
 CppImpl::add_transfer_contact(const std::string& uri)
 {
     auto* box_item = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
-    auto pixbufmanipulator = Interfaces::PixbufManipulator();
+    auto& pixbufmanipulator = static_cast<Interfaces::PixbufManipulator&>(GlobalInstances::pixmapManipulator());
     auto image_buf = pixbufmanipulator.generateAvatar("", uri.empty() ? uri : "sip" + uri);
     auto scaled = pixbufmanipulator.scaleAndFrame(image_buf.get(), QSize(48, 48));
     auto* avatar = gtk_image_new_from_pixbuf(scaled.get());
@@ -1059,6 +1070,11 @@ CppImpl::updateNameAndPhoto()
 void
 CppImpl::updateSmartInfo()
 {
+    VideoWidgetStats local_stats = {};
+    VideoWidgetStats remote_stats = {};
+    video_widget_get_stats(VIDEO_WIDGET(widgets->video_widget), VIDEO_RENDERER_LOCAL, &local_stats);
+    video_widget_get_stats(VIDEO_WIDGET(widgets->video_widget), VIDEO_RENDERER_REMOTE, &remote_stats);
+
     if (!SmartInfoHub::instance().isConference()) {
         gchar* general_information = g_strdup_printf(
             "Call ID: %s", SmartInfoHub::instance().callID().toStdString().c_str());
@@ -1069,26 +1085,38 @@ CppImpl::updateSmartInfo()
                                              "Framerate:\n"
                                              "Video codec:\n"
                                              "Audio codec:\n"
-                                             "Resolution:\n\n"
+                                             "Resolution:\n"
+                                             "Rendered/dropped:\n"
+                                             "Render latency (p50/p95):\n\n"
                                              "Peer\n"
                                              "Framerate:\n"
                                              "Video codec:\n"
                                              "Audio codec:\n"
-                                             "Resolution:");
+                                             "Resolution:\n"
+                                             "Rendered/dropped:\n"
+                                             "Render latency (p50/p95):");
         gtk_label_set_text(GTK_LABEL(widgets->label_smartinfo_description),description);
         g_free(description);
 
-        gchar* value = g_strdup_printf("\n%f\n%s\n%s\n%dx%d\n\n\n%f\n%s\n%s\n%dx%d",
+        gchar* value = g_strdup_printf("\n%f\n%s\n%s\n%dx%d\n%" G_GUINT64_FORMAT "/%" G_GUINT64_FORMAT "\n%s/%s ms\n\n\n%f\n%s\n%s\n%dx%d\n%" G_GUINT64_FORMAT "/%" G_GUINT64_FORMAT "\n%s/%s ms",
                                        (double)SmartInfoHub::instance().localFps(),
                                        SmartInfoHub::instance().localVideoCodec().toStdString().c_str(),
                                        SmartInfoHub::instance().localAudioCodec().toStdString().c_str(),
                                        SmartInfoHub::instance().localWidth(),
                                        SmartInfoHub::instance().localHeight(),
+                                       local_stats.rendered,
+                                       local_stats.dropped,
+                                       latency_to_string(video_widget_stats_get_latency_percentile(&local_stats, 50)).c_str(),
+                                       latency_to_string(video_widget_stats_get_latency_percentile(&local_stats, 95)).c_str(),
                                        (double)SmartInfoHub::instance().remoteFps(),
                                        SmartInfoHub::instance().remoteVideoCodec().toStdString().c_str(),
                                        SmartInfoHub::instance().remoteAudioCodec().toStdString().c_str(),
                                        SmartInfoHub::instance().remoteWidth(),
-                                       SmartInfoHub::instance().remoteHeight());
+                                       SmartInfoHub::instance().remoteHeight(),
+                                       remote_stats.rendered,
+                                       remote_stats.dropped,
+                                       latency_to_string(video_widget_stats_get_latency_percentile(&remote_stats, 50)).c_str(),
+                                       latency_to_string(video_widget_stats_get_latency_percentile(&remote_stats, 95)).c_str());
         gtk_label_set_text(GTK_LABEL(widgets->label_smartinfo_value),value);
         g_free(value);
     } else {
@@ -1101,16 +1129,22 @@ CppImpl::updateSmartInfo()
                                              "Framerate:\n"
                                              "Video codec:\n"
                                              "Audio codec:\n"
-                                             "Resolution:");
+                                             "Resolution:\n"
+                                             "Rendered/dropped:\n"
+                                             "Render latency (p50/p95):");
         gtk_label_set_text(GTK_LABEL(widgets->label_smartinfo_description),description);
         g_free(description);
 
-        gchar* value = g_strdup_printf("\n%f\n%s\n%s\n%dx%d",
+        gchar* value = g_strdup_printf("\n%f\n%s\n%s\n%dx%d\n%" G_GUINT64_FORMAT "/%" G_GUINT64_FORMAT "\n%s/%s ms",
                                        (double)SmartInfoHub::instance().localFps(),
                                        SmartInfoHub::instance().localVideoCodec().toStdString().c_str(),
                                        SmartInfoHub::instance().localAudioCodec().toStdString().c_str(),
                                        SmartInfoHub::instance().localWidth(),
-                                       SmartInfoHub::instance().localHeight());
+                                       SmartInfoHub::instance().localHeight(),
+                                       local_stats.rendered,
+                                       local_stats.dropped,
+                                       latency_to_string(video_widget_stats_get_latency_percentile(&local_stats, 50)).c_str(),
+                                       latency_to_string(video_widget_stats_get_latency_percentile(&local_stats, 95)).c_str());
         gtk_label_set_text(GTK_LABEL(widgets->label_smartinfo_value),value);
         g_free(value);
     }
@@ -1141,12 +1175,12 @@ CppImpl::checkControlsFading()
 
 //==============================================================================
 
-lrc::api::conversation::Info
+const lrc::api::conversation::Info*
 current_call_view_get_conversation(CurrentCallView *self)
 {
-    g_return_val_if_fail(IS_CURRENT_CALL_VIEW(self), lrc::api::conversation::Info());
+    g_return_val_if_fail(IS_CURRENT_CALL_VIEW(self), nullptr);
     auto* priv = CURRENT_CALL_VIEW_GET_PRIVATE(self);
-    return *priv->cpp->conversation;
+    return priv->cpp->conversation;
 }
 
 GtkWidget *
@@ -53,7 +53,7 @@ GType      current_call_view_get_type      (void) G_GNUC_CONST;
 GtkWidget *current_call_view_new           (WebKitChatContainer* view,
                                            AccountInfoPointer const & accountInfo,
                                            lrc::api::conversation::Info* conversation);
-lrc::api::conversation::Info current_call_view_get_conversation(CurrentCallView*);
+const lrc::api::conversation::Info* current_call_view_get_conversation(CurrentCallView*);
 GtkWidget *current_call_view_get_chat_view(CurrentCallView*);
 
 G_END_DECLS
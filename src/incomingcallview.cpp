@@ -323,17 +323,17 @@ incoming_call_view_new(WebKitChatContainer* view,
     return GTK_WIDGET(self);
 }
 
-lrc::api::conversation::Info
+const lrc::api::conversation::Info*
 incoming_call_view_get_conversation(IncomingCallView *self)
 {
-    g_return_val_if_fail(IS_INCOMING_CALL_VIEW(self), lrc::api::conversation::Info());
+    g_return_val_if_fail(IS_INCOMING_CALL_VIEW(self), nullptr);
     auto priv = INCOMING_CALL_VIEW_GET_PRIVATE(self);
 
-    return *priv->conversation_;
+    return priv->conversation_;
 }
 
 void
-incoming_call_view_let_a_message(IncomingCallView* view, lrc::api::conversation::Info conv)
+incoming_call_view_let_a_message(IncomingCallView* view, const lrc::api::conversation::Info& conv)
 {
     g_return_if_fail(IS_INCOMING_CALL_VIEW(view));
     auto priv = INCOMING_CALL_VIEW_GET_PRIVATE(view);
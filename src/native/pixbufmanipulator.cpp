@@ -38,11 +38,102 @@
 
 namespace Interfaces {
 
+/* number of threads decoding profile photos */
+static constexpr int DECODE_THREADS = 2;
+
+struct PixbufManipulator::DecodeJob
+{
+    std::shared_ptr<PixbufManipulator*> self; ///< nullptr once destroyed
+    std::size_t hash;
+    std::string data;
+    GdkPixbuf* photo;
+};
+
+static void
+on_photo_size_prepared(GdkPixbufLoader *loader, gint width, gint height, gpointer max_size_ptr)
+{
+    /* downscale while decoding, so large photos are never held in full */
+    auto max_size = GPOINTER_TO_INT(max_size_ptr);
+    if (width <= max_size && height <= max_size)
+        return;
+
+    if (width > height) {
+        height = std::max(1, height * max_size / width);
+        width = max_size;
+    } else {
+        width = std::max(1, width * max_size / height);
+        height = max_size;
+    }
+    gdk_pixbuf_loader_set_size(loader, width, height);
+}
+
+static GdkPixbuf*
+load_photo(const QByteArray& data, int max_size)
+{
+    auto loader = gdk_pixbuf_loader_new();
+    if (max_size > 0)
+        g_signal_connect(loader, "size-prepared", G_CALLBACK(on_photo_size_prepared), GINT_TO_POINTER(max_size));
+
+    GdkPixbuf *pixbuf = nullptr;
+    auto written = gdk_pixbuf_loader_write(loader,
+                                           reinterpret_cast<const guchar*>(data.constData()),
+                                           data.size(),
+                                           nullptr);
+    /* the loader must be closed even if the data is invalid */
+    if (gdk_pixbuf_loader_close(loader, nullptr) && written) {
+        pixbuf = gdk_pixbuf_loader_get_pixbuf(loader);
+        if (pixbuf)
+            g_object_ref(pixbuf);
+    }
+    g_object_unref(loader);
+
+    return pixbuf;
+}
+
+/**
+ * Decode a profile photo, at most max_size pixels wide and high if max_size
+ * is positive. Can be called from any thread.
+ */
+static GdkPixbuf*
+decode_photo(const QByteArray& data, int max_size)
+{
+    /* Try to load the image from the data provided by lrc vcard utils;
+     * lrc is getting the image data assuming that it is inlined in the vcard,
+     * for now URIs are not supported.
+     *
+     * The format of the data should be either base 64 or ascii (hex), try both
+     */
+    if (auto pixbuf = load_photo(QByteArray::fromBase64(data), max_size))
+        return pixbuf;
+    return load_photo(QByteArray::fromHex(data), max_size);
+}
+
+/**
+ * Take ownership of pixbuf, which may be NULL: g_object_unref() must not be
+ * called on it then.
+ */
+static std::shared_ptr<GdkPixbuf>
+share_pixbuf(GdkPixbuf *pixbuf)
+{
+    if (!pixbuf)
+        return {};
+    return {pixbuf, g_object_unref};
+}
+
 PixbufManipulator::PixbufManipulator()
     : conferenceAvatar_{ring_draw_conference_avatar(FALLBACK_AVATAR_SIZE), g_object_unref}
+    , handle_{std::make_shared<PixbufManipulator*>(this)}
 {
 }
 
+PixbufManipulator::~PixbufManipulator()
+{
+    if (decodePool_)
+        g_thread_pool_free(decodePool_, TRUE, TRUE);
+    /* the decoded photos may still be waiting in the main loop */
+    *handle_ = nullptr;
+}
+
 std::shared_ptr<GdkPixbuf>
 PixbufManipulator::temporaryItemAvatar() const
 {
@@ -122,54 +213,43 @@ PixbufManipulator::generateAvatar(const std::string& alias, const std::string& u
     };
 }
 
-std::shared_ptr<GdkPixbuf>
-PixbufManipulator::scaleAndFrame(const GdkPixbuf *photo,
-                                 const QSize& size,
-                                 bool displayInformation,
-                                 IconStatus status,
-                                 uint unreadMessages)
+std::shared_ptr<cairo_surface_t>
+PixbufManipulator::scaleAndFrameSurface(const GdkPixbuf *photo,
+                                        const QSize& size,
+                                        bool displayInformation,
+                                        IconStatus status,
+                                        uint unreadMessages)
 {
     /**
      * for now, respect the height requested
      * the framing process will add another 10px, so account for that
-     * when scaling the photos
      */
 
     int height = size.height();
     if (size.height() != size.width())
         g_warning("requested contact photo width != height; only respecting the height as the largest dimension");
-    int photo_h = height - 10;
-    int photo_w = photo_h;
-
-    /* scale photo, make sure to respect the request height as the largest dimension*/
-    int w = gdk_pixbuf_get_width(photo);
-    int h = gdk_pixbuf_get_height(photo);
-    if (h > w)
-        photo_w = w * ((double)photo_h / h);
-    if (w > h)
-        photo_h = h * ((double)photo_w / w);
-
-    std::unique_ptr<GdkPixbuf, decltype(g_object_unref)&> scaled_photo{
-        gdk_pixbuf_scale_simple(photo, photo_w, photo_h, GDK_INTERP_BILINEAR),
-        g_object_unref};
-
-    /* frame photo */
-    std::shared_ptr<GdkPixbuf> result {
-        ring_frame_avatar(scaled_photo.get()),
-        g_object_unref
-    };
-
-    /* draw information */
-    if (displayInformation) {
-        /* draw status */
-        result.reset(ring_draw_status(result.get(), status), g_object_unref);
 
-        /* draw visual notification for unread messages */
-        if (unreadMessages)
-            result.reset(ring_draw_unread_messages(result.get(), unreadMessages), g_object_unref);
-    }
+    /* frame the photo and draw the information in one surface */
+    return {
+        ring_draw_avatar(photo,
+                         height,
+                         displayInformation ? status : IconStatus::INVALID,
+                         displayInformation ? unreadMessages : 0),
+        cairo_surface_destroy
+    };
+}
 
-    return result;
+std::shared_ptr<GdkPixbuf>
+PixbufManipulator::scaleAndFrame(const GdkPixbuf *photo,
+                                 const QSize& size,
+                                 bool displayInformation,
+                                 IconStatus status,
+                                 uint unreadMessages)
+{
+    auto surface = scaleAndFrameSurface(photo, size, displayInformation, status, unreadMessages);
+    return share_pixbuf(gdk_pixbuf_get_from_surface(surface.get(), 0, 0,
+                                                    cairo_image_surface_get_width(surface.get()),
+                                                    cairo_image_surface_get_height(surface.get())));
 }
 
 QVariant
@@ -215,54 +295,111 @@ PixbufManipulator::contactPhoto(Person* c, const QSize& size, bool displayInform
 QVariant PixbufManipulator::personPhoto(const QByteArray& data, const QString& type)
 {
     Q_UNUSED(type);
-    /* Try to load the image from the data provided by lrc vcard utils;
-     * lrc is getting the image data assuming that it is inlined in the vcard,
-     * for now URIs are not supported.
-     *
-     * The format of the data should be either base 64 or ascii (hex), try both
-     */
 
-    GError *error = NULL;
-    GdkPixbuf *pixbuf = NULL;
-    GInputStream *stream = NULL;
+    if (auto pixbuf = decode_photo(data, 0)) {
+        std::shared_ptr<GdkPixbuf> avatar(pixbuf, g_object_unref);
+        return QVariant::fromValue(avatar);
+    }
 
-    /* first try using base64 */
-    QByteArray ba64 = QByteArray::fromBase64(data);
-    stream = g_memory_input_stream_new_from_data(ba64.constData(),
-                                                 ba64.size(),
-                                                 NULL);
+    /* could not load image, return emtpy QVariant */
+    return QVariant();
+}
 
-    pixbuf = gdk_pixbuf_new_from_stream(stream, NULL, &error);
-    g_input_stream_close(stream, NULL, NULL);
-    g_object_unref(stream);
+void
+PixbufManipulator::decodePhoto(gpointer data, G_GNUC_UNUSED gpointer user_data)
+{
+    auto job = static_cast<DecodeJob*>(data);
+    job->photo = decode_photo(QByteArray::fromRawData(job->data.data(), job->data.size()), DECODED_PHOTO_SIZE);
+    g_idle_add(onPhotoDecoded, job);
+}
 
-    if (!pixbuf) {
-        // g_debug("failed decoding person photo using base64: %s", error->message);
-        g_clear_error(&error);
+gboolean
+PixbufManipulator::onPhotoDecoded(gpointer data)
+{
+    std::unique_ptr<DecodeJob> job(static_cast<DecodeJob*>(data));
+    auto photo = share_pixbuf(job->photo);
+    auto self = *job->self;
+    if (!self)
+        return G_SOURCE_REMOVE;
+
+    self->storeDecodedPhoto(job->hash, photo);
+
+    auto it = self->pendingDecodes_.find(job->hash);
+    if (it != self->pendingDecodes_.end()) {
+        auto callbacks = std::move(it->second);
+        self->pendingDecodes_.erase(it);
+        for (const auto& ready : callbacks)
+            ready();
+    }
 
-        /* failed with base64, try hex */
-        QByteArray baHex = QByteArray::fromHex(data);
-        stream = g_memory_input_stream_new_from_data(baHex.constData(),
-                                                     baHex.size(),
-                                                     NULL);
+    return G_SOURCE_REMOVE;
+}
 
-        pixbuf = gdk_pixbuf_new_from_stream(stream, NULL, &error);
-        g_input_stream_close(stream, NULL, NULL);
-        g_object_unref(stream);
+void
+PixbufManipulator::storeDecodedPhoto(std::size_t hash, const std::shared_ptr<GdkPixbuf>& photo)
+{
+    auto it = decodedPhotosIndex_.find(hash);
+    if (it != decodedPhotosIndex_.end()) {
+        decodedPhotos_.erase(it->second);
+        decodedPhotosIndex_.erase(it);
+    }
 
-        if (!pixbuf) {
-            // g_debug("failed decoding person photo using hex (ASCII): %s", error->message);
-            g_clear_error(&error);
-        }
+    decodedPhotos_.emplace_front(hash, photo);
+    decodedPhotosIndex_[hash] = decodedPhotos_.begin();
+
+    if (decodedPhotos_.size() > DECODED_PHOTOS_CAPACITY) {
+        decodedPhotosIndex_.erase(decodedPhotos_.back().first);
+        decodedPhotos_.pop_back();
     }
+}
 
-    if (pixbuf) {
-        std::shared_ptr<GdkPixbuf> avatar(pixbuf, g_object_unref);
-        return QVariant::fromValue(avatar);
+std::shared_ptr<GdkPixbuf>
+PixbufManipulator::decodedPhoto(const std::string& data, const std::function<void()>* ready)
+{
+    auto hash = std::hash<std::string>()(data);
+    auto it = decodedPhotosIndex_.find(hash);
+    if (it != decodedPhotosIndex_.end()) {
+        decodedPhotos_.splice(decodedPhotos_.begin(), decodedPhotos_, it->second);
+        return it->second->second;
     }
 
-    /* could not load image, return emtpy QVariant */
-    return QVariant();
+    if (!ready) {
+        auto photo = share_pixbuf(
+            decode_photo(QByteArray::fromRawData(data.data(), data.size()), DECODED_PHOTO_SIZE));
+        storeDecodedPhoto(hash, photo);
+        return photo;
+    }
+
+    auto& callbacks = pendingDecodes_[hash];
+    callbacks.push_back(*ready);
+    if (callbacks.size() == 1) {
+        if (!decodePool_)
+            decodePool_ = g_thread_pool_new(decodePhoto, nullptr, DECODE_THREADS, FALSE, nullptr);
+        g_thread_pool_push(decodePool_, new DecodeJob{handle_, hash, data, nullptr}, nullptr);
+    }
+    return nullptr;
+}
+
+std::shared_ptr<cairo_surface_t>
+PixbufManipulator::cachedPhoto(const std::string& key,
+                               const std::function<std::shared_ptr<cairo_surface_t>()>& draw)
+{
+    auto it = conversationPhotosIndex_.find(key);
+    if (it != conversationPhotosIndex_.end()) {
+        conversationPhotos_.splice(conversationPhotos_.begin(), conversationPhotos_, it->second);
+        return it->second->second;
+    }
+
+    auto photo = draw();
+    conversationPhotos_.emplace_front(key, photo);
+    conversationPhotosIndex_[key] = conversationPhotos_.begin();
+
+    if (conversationPhotos_.size() > CONVERSATION_PHOTOS_CAPACITY) {
+        conversationPhotosIndex_.erase(conversationPhotos_.back().first);
+        conversationPhotos_.pop_back();
+    }
+
+    return photo;
 }
 
 QVariant
@@ -271,33 +408,98 @@ PixbufManipulator::conversationPhoto(const lrc::api::conversation::Info& convers
                                      const QSize& size,
                                      bool displayInformation)
 {
-    auto contacts = conversationInfo.participants;
+    auto surface = drawConversationPhoto(conversationInfo, accountInfo, size, displayInformation, nullptr);
+    auto photo = share_pixbuf(gdk_pixbuf_get_from_surface(surface.get(), 0, 0,
+                                                          cairo_image_surface_get_width(surface.get()),
+                                                          cairo_image_surface_get_height(surface.get())));
+    return QVariant::fromValue(photo);
+}
+
+std::shared_ptr<GdkPixbuf>
+PixbufManipulator::profilePhoto(const std::string& data,
+                                const QSize& size,
+                                bool displayInformation,
+                                IconStatus status)
+{
+    std::shared_ptr<GdkPixbuf> photo;
+    if (!data.empty())
+        photo = decodedPhoto(data, nullptr);
+    if (!photo)
+        return {};
+
+    // same key as the photos of drawConversationPhoto(), without unread messages
+    auto key = "photo:" + std::to_string(std::hash<std::string>()(data))
+        + "\n" + std::to_string(size.width()) + "x" + std::to_string(size.height())
+        + "\n" + std::to_string(displayInformation)
+        + "\n" + std::to_string(static_cast<int>(status))
+        + "\n0";
+    auto surface = cachedPhoto(key, [&] {
+        return scaleAndFrameSurface(photo.get(), size, displayInformation, status);
+    });
+    return share_pixbuf(gdk_pixbuf_get_from_surface(surface.get(), 0, 0,
+                                                    cairo_image_surface_get_width(surface.get()),
+                                                    cairo_image_surface_get_height(surface.get())));
+}
+
+std::shared_ptr<cairo_surface_t>
+PixbufManipulator::conversationPhotoAsync(const lrc::api::conversation::Info& conversationInfo,
+                                          const lrc::api::account::Info& accountInfo,
+                                          const QSize& size,
+                                          bool displayInformation,
+                                          const std::function<void()>& ready)
+{
+    return drawConversationPhoto(conversationInfo, accountInfo, size, displayInformation, &ready);
+}
+
+std::shared_ptr<cairo_surface_t>
+PixbufManipulator::drawConversationPhoto(const lrc::api::conversation::Info& conversationInfo,
+                                         const lrc::api::account::Info& accountInfo,
+                                         const QSize& size,
+                                         bool displayInformation,
+                                         const std::function<void()>* ready)
+{
+    const auto& contacts = conversationInfo.participants;
     if (!contacts.empty()) {
         try {
             // Get first contact photo
             auto contactUri = contacts.front();
-            auto contactInfo = accountInfo.contactModel->getContact(contactUri);
-            auto contactPhoto = contactInfo.profileInfo.avatar;
+            const auto& contactInfo = accountInfo.contactModel->getContact(contactUri);
+            const auto& contactPhoto = contactInfo.profileInfo.avatar;
             auto bestName = contactInfo.profileInfo.alias.empty()? contactInfo.registeredName : contactInfo.profileInfo.alias;
             auto unreadMessages = conversationInfo.unreadMessages;
             auto status = contactInfo.isPresent? IconStatus::PRESENT : IconStatus::ABSENT;
+
+            // what the photo is drawn from, followed by how it is composited
+            std::string source;
+            std::function<std::shared_ptr<cairo_surface_t>()> draw;
+            std::shared_ptr<GdkPixbuf> photo;
             if (accountInfo.profileInfo.type == lrc::api::profile::Type::SIP && contactInfo.profileInfo.type == lrc::api::profile::Type::TEMPORARY)
             {
-                return QVariant::fromValue(scaleAndFrame(generateAvatar("", "").get(), size, displayInformation, status));
+                source = "sip";
+                draw = [&] { return scaleAndFrameSurface(generateAvatar("", "").get(), size, displayInformation, status); };
             } else if (accountInfo.profileInfo.type == lrc::api::profile::Type::SIP) {
-                return QVariant::fromValue(scaleAndFrame(generateAvatar("", "sip:" + contactInfo.profileInfo.uri).get(), size, displayInformation, status));
+                source = "sip:" + contactInfo.profileInfo.uri;
+                draw = [&] { return scaleAndFrameSurface(generateAvatar("", source).get(), size, displayInformation, status); };
             } else if (contactInfo.profileInfo.type == lrc::api::profile::Type::TEMPORARY && contactInfo.profileInfo.uri.empty()) {
-                return QVariant::fromValue(scaleAndFrame(temporaryItemAvatar().get(), size, false, status, unreadMessages));
-            } else if (!contactPhoto.empty()) {
-                QByteArray byteArray(contactPhoto.c_str(), contactPhoto.length());
-                QVariant photo = personPhoto(byteArray);
-                return QVariant::fromValue(scaleAndFrame(photo.value<std::shared_ptr<GdkPixbuf>>().get(), size, displayInformation, status, unreadMessages));
+                source = "temporary";
+                draw = [&] { return scaleAndFrameSurface(temporaryItemAvatar().get(), size, false, status, unreadMessages); };
+            } else if (!contactPhoto.empty() && (photo = decodedPhoto(contactPhoto, ready))) {
+                source = "photo:" + std::to_string(std::hash<std::string>()(contactPhoto));
+                draw = [&] { return scaleAndFrameSurface(photo.get(), size, displayInformation, status, unreadMessages); };
             } else {
-                return QVariant::fromValue(scaleAndFrame(generateAvatar(bestName, "ring:" + contactInfo.profileInfo.uri).get(), size, displayInformation, status, unreadMessages));
+                // also drawn while the photo is decoded, or if it is invalid
+                source = "ring:" + contactInfo.profileInfo.uri + "\n" + bestName;
+                draw = [&] { return scaleAndFrameSurface(generateAvatar(bestName, "ring:" + contactInfo.profileInfo.uri).get(), size, displayInformation, status, unreadMessages); };
             }
+
+            auto key = source + "\n" + std::to_string(size.width()) + "x" + std::to_string(size.height())
+                + "\n" + std::to_string(displayInformation)
+                + "\n" + std::to_string(static_cast<int>(status))
+                + "\n" + std::to_string(unreadMessages);
+            return cachedPhoto(key, draw);
         } catch (...) {}
     }
-    return QVariant::fromValue(scaleAndFrame(generateAvatar("", "").get(), size, displayInformation));
+    return scaleAndFrameSurface(generateAvatar("", "").get(), size, displayInformation);
 
 }
 
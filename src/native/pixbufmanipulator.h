@@ -21,7 +21,12 @@
 #pragma once
 
 #include <gtk/gtk.h>
+#include <functional>
+#include <list>
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include <interfaces/pixmapmanipulatori.h>
 #include "../utils/drawing.h"
 
@@ -39,6 +44,7 @@ class PixbufManipulator : public PixmapManipulatorI {
     constexpr static int FALLBACK_AVATAR_SIZE {100};
 public:
     PixbufManipulator();
+    ~PixbufManipulator();
 
     QVariant callPhoto(Call* c, const QSize& size, bool displayInformation = true) override;
     QVariant callPhoto(const ContactMethod* n, const QSize& size, bool displayInformation = true) override;
@@ -46,6 +52,28 @@ public:
                                const lrc::api::account::Info& accountInfo,
                                const QSize& size,
                                bool displayInformation = true) override;
+    /**
+     * Same as conversationPhoto(), except that a profile photo which was not
+     * decoded yet is decoded on a worker thread. The generated avatar is
+     * returned meanwhile, and ready is called on the main thread once the
+     * photo is decoded, so it can be requested again. The surface can be
+     * painted as is, e.g. by a cell renderer.
+     * Only for the long lived instance of GlobalInstances.
+     */
+    std::shared_ptr<cairo_surface_t> conversationPhotoAsync(const lrc::api::conversation::Info& conversation,
+                                                           const lrc::api::account::Info& accountInfo,
+                                                           const QSize& size,
+                                                           bool displayInformation,
+                                                           const std::function<void()>& ready);
+    /**
+     * Returns the profile photo encoded in the vCard data, framed at size, or
+     * nullptr if it can't be decoded. Both the decoded and the framed photos
+     * are cached, so prefer it to personPhoto() for displaying a profile.
+     */
+    std::shared_ptr<GdkPixbuf> profilePhoto(const std::string& data,
+                                            const QSize& size,
+                                            bool displayInformation = false,
+                                            IconStatus status = IconStatus::INVALID);
     QVariant contactPhoto(Person* c, const QSize& size, bool displayInformation = true) override;
     QVariant personPhoto(const QByteArray& data, const QString& type = "PNG") override;
 
@@ -71,9 +99,53 @@ public:
     std::shared_ptr<GdkPixbuf> generateAvatar(const std::string& alias, const std::string& uri) const;
 
     std::shared_ptr<GdkPixbuf> scaleAndFrame(const GdkPixbuf *photo, const QSize &size, bool displayInformation = false, IconStatus status = IconStatus::INVALID, uint unreadMessages = 0);
+    std::shared_ptr<cairo_surface_t> scaleAndFrameSurface(const GdkPixbuf *photo, const QSize &size, bool displayInformation = false, IconStatus status = IconStatus::INVALID, uint unreadMessages = 0);
 
   private:
+    constexpr static std::size_t CONVERSATION_PHOTOS_CAPACITY {256};
+    /* profile photos are decoded at most at this size, which is enough for
+     * the conversation list, the call views and the avatar settings */
+    constexpr static int DECODED_PHOTO_SIZE {150};
+    constexpr static std::size_t DECODED_PHOTOS_CAPACITY {256};
+
+    struct DecodeJob;
+    static void decodePhoto(gpointer job, gpointer user_data);
+    static gboolean onPhotoDecoded(gpointer job);
+
+    std::shared_ptr<cairo_surface_t> drawConversationPhoto(const lrc::api::conversation::Info& conversation,
+                                                          const lrc::api::account::Info& accountInfo,
+                                                          const QSize& size,
+                                                          bool displayInformation,
+                                                          const std::function<void()>* ready);
+
+    /* returns the decoded profile photo, or nullptr if it is invalid, or if
+     * ready is set and the photo is being decoded in the background */
+    std::shared_ptr<GdkPixbuf> decodedPhoto(const std::string& data, const std::function<void()>* ready);
+    void storeDecodedPhoto(std::size_t hash, const std::shared_ptr<GdkPixbuf>& photo);
+
+    /* returns the photo cached for key, or draws and caches it */
+    std::shared_ptr<cairo_surface_t> cachedPhoto(const std::string& key,
+                                                 const std::function<std::shared_ptr<cairo_surface_t>()>& draw);
+
     std::shared_ptr<GdkPixbuf> conferenceAvatar_;
+
+    /* composited conversation photos, keyed by what they are drawn from, so
+     * an updated profile photo gets a new entry and the old one ages out */
+    using PhotoEntry = std::pair<std::string, std::shared_ptr<cairo_surface_t>>;
+    std::list<PhotoEntry> conversationPhotos_; ///< most recently used first
+    std::unordered_map<std::string, std::list<PhotoEntry>::iterator> conversationPhotosIndex_;
+
+    /* decoded profile photos, by hash of their vCard data; nullptr when the
+     * data could not be decoded */
+    using DecodedEntry = std::pair<std::size_t, std::shared_ptr<GdkPixbuf>>;
+    std::list<DecodedEntry> decodedPhotos_; ///< most recently used first
+    std::unordered_map<std::size_t, std::list<DecodedEntry>::iterator> decodedPhotosIndex_;
+
+    GThreadPool* decodePool_ {nullptr}; ///< created on first asynchronous decode
+    /* handed to the decode jobs instead of this, and cleared when destroyed,
+     * since their completion may be dispatched after the destruction */
+    std::shared_ptr<PixbufManipulator*> handle_;
+    std::unordered_map<std::size_t, std::vector<std::function<void()>>> pendingDecodes_;
 };
 
 } // namespace Interfaces
@@ -38,6 +38,7 @@
 #include <api/lrc.h>
 #include <api/newaccountmodel.h>
 #include <api/newcallmodel.h>
+#include <globalinstances.h>
 #include <api/behaviorcontroller.h>
 #include "api/account.h"
 #include <media/textrecording.h>
@@ -48,6 +49,7 @@
 #include "newaccountsettingsview.h"
 #include "accountmigrationview.h"
 #include "accountcreationwizard.h"
+#include "avatarmanipulation.h"
 #include "chatview.h"
 #include "conversationsview.h"
 #include "currentcallview.h"
@@ -249,18 +251,11 @@ render_account_avatar(G_GNUC_UNUSED GtkCellLayout* cell_layout,
     } else if (statusStr == "CONNECTED") {
         iconStatus = IconStatus::CONNECTED;
     }
-    auto default_avatar = Interfaces::PixbufManipulator().generateAvatar("", "");
-    auto default_scaled = Interfaces::PixbufManipulator().scaleAndFrame(default_avatar.get(), QSize(32, 32), true, iconStatus);
-    auto photo = default_scaled;
-
-    std::string photostr = avatar;
-    if (!photostr.empty()) {
-        QByteArray byteArray(photostr.c_str(), photostr.length());
-        QVariant avatar = Interfaces::PixbufManipulator().personPhoto(byteArray);
-        auto pixbuf_photo = Interfaces::PixbufManipulator().scaleAndFrame(avatar.value<std::shared_ptr<GdkPixbuf>>().get(), QSize(32, 32), true, iconStatus);
-        if (avatar.isValid()) {
-            photo = pixbuf_photo;
-        }
+    auto& pixbufManipulator = static_cast<Interfaces::PixbufManipulator&>(GlobalInstances::pixmapManipulator());
+    auto photo = pixbufManipulator.profilePhoto(avatar ? avatar : "", QSize(32, 32), true, iconStatus);
+    if (!photo) {
+        auto default_avatar = pixbufManipulator.generateAvatar("", "");
+        photo = pixbufManipulator.scaleAndFrame(default_avatar.get(), QSize(32, 32), true, iconStatus);
     }
 
     g_object_set(G_OBJECT(cell), "width", 32, nullptr);
@@ -293,7 +288,7 @@ public:
 
     void init();
     void updateLrc(const std::string& accountId, const std::string& accountIdToFlagFreeable = "");
-    void changeView(GType type, lrc::api::conversation::Info conversation = {});
+    void changeView(GType type, const lrc::api::conversation::Info& conversation = {});
     void enterFullScreen();
     void leaveFullScreen();
     void toggleFullScreen();
@@ -306,7 +301,7 @@ public:
     void enterSettingsView();
     void leaveSettingsView();
 
-    lrc::api::conversation::Info getCurrentConversation(GtkWidget* frame_call);
+    std::string getCurrentConversationUid(GtkWidget* frame_call);
 
     void showAccountSelectorWidget(bool show = true);
     std::size_t refreshAccountSelectorWidget(int selection_row = -1, const std::string& selected = "");
@@ -324,6 +319,8 @@ public:
     bool show_settings = false;
     bool is_fullscreen = false;
     bool has_cleared_all_history = false;
+    guint prewarmChatContainerSource_ = 0;
+    GCancellable* normalizeAvatarsCancellable_ = nullptr;
 
     int smartviewPageNum = 0;
     int contactRequestsPageNum = 0;
@@ -355,10 +352,10 @@ private:
     CppImpl(const CppImpl&) = delete;
     CppImpl& operator=(const CppImpl&) = delete;
 
-    GtkWidget* displayWelcomeView(lrc::api::conversation::Info);
-    GtkWidget* displayIncomingView(lrc::api::conversation::Info);
-    GtkWidget* displayCurrentCallView(lrc::api::conversation::Info);
-    GtkWidget* displayChatView(lrc::api::conversation::Info);
+    GtkWidget* displayWelcomeView(const lrc::api::conversation::Info&);
+    GtkWidget* displayIncomingView(const lrc::api::conversation::Info&);
+    GtkWidget* displayCurrentCallView(const lrc::api::conversation::Info&);
+    GtkWidget* displayChatView(const lrc::api::conversation::Info&);
 
     // Callbacks used as LRC Qt slot
     void slotAccountAddedFromLrc(const std::string& id);
@@ -372,16 +369,18 @@ private:
     void slotFilterChanged();
     void slotNewConversation(const std::string& uid);
     void slotConversationRemoved(const std::string& uid);
-    void slotShowChatView(const std::string& id, lrc::api::conversation::Info origin);
-    void slotShowLeaveMessageView(lrc::api::conversation::Info conv);
-    void slotShowCallView(const std::string& id, lrc::api::conversation::Info origin);
-    void slotShowIncomingCallView(const std::string& id, lrc::api::conversation::Info origin);
+    void slotShowChatView(const std::string& id, const lrc::api::conversation::Info& origin);
+    void slotShowLeaveMessageView(const lrc::api::conversation::Info& conv);
+    void slotShowCallView(const std::string& id, const lrc::api::conversation::Info& origin);
+    void slotShowIncomingCallView(const std::string& id, const lrc::api::conversation::Info& origin);
     void slotNewTrustRequest(const std::string& id, const std::string& contactUri);
     void slotCloseTrustRequest(const std::string& id, const std::string& contactUri);
     void slotNewInteraction(const std::string& accountId, const std::string& conversation,
                                 uint64_t, const lrc::api::interaction::Info& interaction);
     void slotCloseInteraction(const std::string& accountId, const std::string& conversation, uint64_t);
     void slotProfileUpdated(const std::string& id);
+
+    void normalizeAccountAvatars();
 };
 
 inline namespace gtk_callbacks
@@ -571,13 +570,13 @@ on_dtmf_pressed(RingMainWindow* self, GdkEventKey* event, gpointer user_data)
 
     // Get current conversation
     auto current_view = gtk_bin_get_child(GTK_BIN(priv->frame_call));
-    lrc::api::conversation::Info current_item;
+    const lrc::api::conversation::Info* current_item = nullptr;
     if (IS_CURRENT_CALL_VIEW(current_view))
        current_item = current_call_view_get_conversation(CURRENT_CALL_VIEW(current_view));
     else
        return GDK_EVENT_PROPAGATE;
 
-    if (current_item.callId.empty())
+    if (!current_item || current_item->callId.empty())
        return GDK_EVENT_PROPAGATE;
 
     // pass the character that was entered to be played by the daemon;
@@ -585,7 +584,7 @@ on_dtmf_pressed(RingMainWindow* self, GdkEventKey* event, gpointer user_data)
     guint32 unicode_val = gdk_keyval_to_unicode(event->keyval);
     QString val = QString::fromUcs4(&unicode_val, 1);
     g_debug("attempting to play DTMF tone during ongoing call: %s", val.toUtf8().constData());
-    priv->cpp->accountInfo_->callModel->playDTMF(current_item.callId, val.toStdString());
+    priv->cpp->accountInfo_->callModel->playDTMF(current_item->callId, val.toStdString());
     // always propagate the key, so we don't steal accelerators/shortcuts
     return GDK_EVENT_PROPAGATE;
 }
@@ -956,6 +955,10 @@ CppImpl::init()
 
     update_data_transfer(lrc_->getDataTransferModel(), widgets->settings);
 
+    /* avatars of older profiles were stored at the size they were picked */
+    normalizeAvatarsCancellable_ = g_cancellable_new();
+    normalizeAccountAvatars();
+
     /* search-entry-places-call setting */
     on_search_entry_places_call_changed(widgets->settings, "search-entry-places-call", self);
     g_signal_connect(widgets->settings, "changed::search-entry-places-call",
@@ -1061,8 +1064,14 @@ CppImpl::init()
                                    C_("Please try to make the translation 50 chars or less so that it fits into the layout",
                                       "Search contacts or enter number"));
 
-    /* init chat webkit container so that it starts loading before the first time we need it*/
-    (void)webkitChatContainer();
+    /* init chat webkit container so that it starts loading before the first time we need it,
+     * once the main window is displayed */
+    prewarmChatContainerSource_ = g_idle_add_full(G_PRIORITY_LOW, [](gpointer user_data) {
+        auto* cpp = static_cast<CppImpl*>(user_data);
+        cpp->prewarmChatContainerSource_ = 0;
+        cpp->webkitChatContainer();
+        return G_SOURCE_REMOVE;
+    }, this, nullptr);
 
     // setup account selector and select the first account
     refreshAccountSelectorWidget(0);
@@ -1127,6 +1136,13 @@ CppImpl::init()
 
 CppImpl::~CppImpl()
 {
+    if (prewarmChatContainerSource_)
+        g_source_remove(prewarmChatContainerSource_);
+    if (normalizeAvatarsCancellable_) {
+        g_cancellable_cancel(normalizeAvatarsCancellable_);
+        g_object_unref(normalizeAvatarsCancellable_);
+    }
+
     QObject::disconnect(showLeaveMessageViewConnection_);
     QObject::disconnect(showChatViewConnection_);
     QObject::disconnect(showIncomingViewConnection_);
@@ -1154,7 +1170,7 @@ CppImpl::~CppImpl()
 }
 
 void
-CppImpl::changeView(GType type, lrc::api::conversation::Info conversation)
+CppImpl::changeView(GType type, const lrc::api::conversation::Info& conversation)
 {
     leaveFullScreen();
     gtk_container_remove(GTK_CONTAINER(widgets->frame_call),
@@ -1176,7 +1192,7 @@ CppImpl::changeView(GType type, lrc::api::conversation::Info conversation)
 }
 
 GtkWidget*
-CppImpl::displayWelcomeView(lrc::api::conversation::Info conversation)
+CppImpl::displayWelcomeView(const lrc::api::conversation::Info& conversation)
 {
     (void) conversation;
 
@@ -1189,14 +1205,14 @@ CppImpl::displayWelcomeView(lrc::api::conversation::Info conversation)
 }
 
 GtkWidget*
-CppImpl::displayIncomingView(lrc::api::conversation::Info conversation)
+CppImpl::displayIncomingView(const lrc::api::conversation::Info& conversation)
 {
     chatViewConversation_.reset(new lrc::api::conversation::Info(conversation));
     return incoming_call_view_new(webkitChatContainer(), lrc_->getAVModel(), accountInfo_, chatViewConversation_.get());
 }
 
 GtkWidget*
-CppImpl::displayCurrentCallView(lrc::api::conversation::Info conversation)
+CppImpl::displayCurrentCallView(const lrc::api::conversation::Info& conversation)
 {
     chatViewConversation_.reset(new lrc::api::conversation::Info(conversation));
     auto* new_view = current_call_view_new(webkitChatContainer(),
@@ -1216,7 +1232,7 @@ CppImpl::displayCurrentCallView(lrc::api::conversation::Info conversation)
 }
 
 GtkWidget*
-CppImpl::displayChatView(lrc::api::conversation::Info conversation)
+CppImpl::displayChatView(const lrc::api::conversation::Info& conversation)
 {
     chatViewConversation_.reset(new lrc::api::conversation::Info(conversation));
     auto* new_view = chat_view_new(webkitChatContainer(), accountInfo_, chatViewConversation_.get());
@@ -1284,10 +1300,13 @@ CppImpl::resetToWelcome()
     auto selection_contact_request = gtk_tree_view_get_selection(GTK_TREE_VIEW(widgets->treeview_contact_requests));
     gtk_tree_selection_unselect_all(GTK_TREE_SELECTION(selection_contact_request));
     auto* old_view = gtk_bin_get_child(GTK_BIN(widgets->frame_call));
-    lrc::api::conversation::Info current_item;
+    const lrc::api::conversation::Info* current_item = nullptr;
     if (IS_CHAT_VIEW(old_view))
         current_item = chat_view_get_conversation(CHAT_VIEW(old_view));
-    changeView(RING_WELCOME_VIEW_TYPE, current_item);
+    if (current_item)
+        changeView(RING_WELCOME_VIEW_TYPE, *current_item);
+    else
+        changeView(RING_WELCOME_VIEW_TYPE);
 }
 
 void
@@ -1630,15 +1649,15 @@ CppImpl::updateLrc(const std::string& id, const std::string& accountIdToFlagFree
 
     showChatViewConnection_ = QObject::connect(&lrc_->getBehaviorController(),
                                                &lrc::api::BehaviorController::showChatView,
-                                               [this] (const std::string& id, lrc::api::conversation::Info origin) { slotShowChatView(id, origin); });
+                                               [this] (const std::string& id, const lrc::api::conversation::Info& origin) { slotShowChatView(id, origin); });
 
     showLeaveMessageViewConnection_ = QObject::connect(&lrc_->getBehaviorController(),
                                                &lrc::api::BehaviorController::showLeaveMessageView,
-                                               [this] (const std::string&, lrc::api::conversation::Info conv) { slotShowLeaveMessageView(conv); });
+                                               [this] (const std::string&, const lrc::api::conversation::Info& conv) { slotShowLeaveMessageView(conv); });
 
     showCallViewConnection_ = QObject::connect(&lrc_->getBehaviorController(),
                                                &lrc::api::BehaviorController::showCallView,
-                                               [this] (const std::string& id, lrc::api::conversation::Info origin) { slotShowCallView(id, origin); });
+                                               [this] (const std::string& id, const lrc::api::conversation::Info& origin) { slotShowCallView(id, origin); });
 
     newTrustRequestNotification_ = QObject::connect(&lrc_->getBehaviorController(),
                                                     &lrc::api::BehaviorController::newTrustRequest,
@@ -1650,7 +1669,7 @@ CppImpl::updateLrc(const std::string& id, const std::string& accountIdToFlagFree
 
     showIncomingViewConnection_ = QObject::connect(&lrc_->getBehaviorController(),
                                                    &lrc::api::BehaviorController::showIncomingCallView,
-                                                   [this] (const std::string& id, lrc::api::conversation::Info origin)
+                                                   [this] (const std::string& id, const lrc::api::conversation::Info& origin)
                                                           { slotShowIncomingCallView(id, origin); });
 
     slotNewInteraction_ = QObject::connect(&lrc_->getBehaviorController(),
@@ -1673,6 +1692,9 @@ CppImpl::updateLrc(const std::string& id, const std::string& accountIdToFlagFree
 void
 CppImpl::slotAccountAddedFromLrc(const std::string& id)
 {
+    // an imported account may come with an avatar of any size
+    normalizeAccountAvatars();
+
     auto currentIdx = gtk_combo_box_get_active(GTK_COMBO_BOX(widgets->combobox_account_selector));
     if (currentIdx == -1)
         currentIdx = 0; // If no account selected, select the first account
@@ -1733,11 +1755,10 @@ CppImpl::slotInvalidAccountFromLrc(const std::string& id)
     }
 }
 
-lrc::api::conversation::Info
-CppImpl::getCurrentConversation(GtkWidget* frame_call)
+std::string
+CppImpl::getCurrentConversationUid(GtkWidget* frame_call)
 {
-    lrc::api::conversation::Info current_item;
-    current_item.uid = "-1";
+    const lrc::api::conversation::Info* current_item = nullptr;
     if (IS_CHAT_VIEW(frame_call)) {
         current_item = chat_view_get_conversation(CHAT_VIEW(frame_call));
     } else if (IS_CURRENT_CALL_VIEW(frame_call)) {
@@ -1746,7 +1767,7 @@ CppImpl::getCurrentConversation(GtkWidget* frame_call)
         current_item = incoming_call_view_get_conversation(INCOMING_CALL_VIEW(frame_call));
     }
 
-    return current_item;
+    return current_item ? current_item->uid : "-1";
 }
 
 void
@@ -1765,7 +1786,7 @@ CppImpl::slotAccountStatusChanged(const std::string& id)
     refreshAccountSelectorWidget(currentIdx);
 
     auto* frame_call = gtk_bin_get_child(GTK_BIN(widgets->frame_call));
-    conversations_view_select_conversation(CONVERSATIONS_VIEW(widgets->treeview_conversations), getCurrentConversation(frame_call).uid);
+    conversations_view_select_conversation(CONVERSATIONS_VIEW(widgets->treeview_conversations), getCurrentConversationUid(frame_call));
 
     if (IS_CHAT_VIEW(frame_call)) {
         chat_view_update_temporary(CHAT_VIEW(frame_call));
@@ -1779,9 +1800,7 @@ CppImpl::slotConversationCleared(const std::string& uid)
     auto* old_view = gtk_bin_get_child(GTK_BIN(widgets->frame_call));
     g_return_if_fail(IS_CHAT_VIEW(old_view));
 
-    lrc::api::conversation::Info current_item = getCurrentConversation(old_view);
-
-    if (current_item.uid == uid) {
+    if (getCurrentConversationUid(old_view) == uid) {
         // We are on the conversation cleared.
         // Go to welcome view because user doesn't want this conversation
         // TODO go to first conversation?
@@ -1794,7 +1813,7 @@ CppImpl::slotModelSorted()
 {
     // Synchronize selection when sorted and update pending icon
     auto* frame_call = gtk_bin_get_child(GTK_BIN(widgets->frame_call));
-    conversations_view_select_conversation(CONVERSATIONS_VIEW(widgets->treeview_conversations), getCurrentConversation(frame_call).uid);
+    conversations_view_select_conversation(CONVERSATIONS_VIEW(widgets->treeview_conversations), getCurrentConversationUid(frame_call));
     refreshPendingContactRequestTab();
 }
 
@@ -1874,16 +1893,16 @@ CppImpl::slotFilterChanged()
 {
     // Synchronize selection when filter changes
     auto* old_view = gtk_bin_get_child(GTK_BIN(widgets->frame_call));
-    auto current_item = getCurrentConversation(old_view);
-    conversations_view_select_conversation(CONVERSATIONS_VIEW(widgets->treeview_conversations), current_item.uid);
+    auto current_uid = getCurrentConversationUid(old_view);
+    conversations_view_select_conversation(CONVERSATIONS_VIEW(widgets->treeview_conversations), current_uid);
 
     // Get if conversation still exists.
     auto& conversationModel = accountInfo_->conversationModel;
-    auto conversations = conversationModel->allFilteredConversations();
+    const auto& conversations = conversationModel->allFilteredConversations();
     auto conversation = std::find_if(
         conversations.begin(), conversations.end(),
-        [current_item](const lrc::api::conversation::Info& conversation) {
-            return current_item.uid == conversation.uid;
+        [&current_uid](const lrc::api::conversation::Info& conversation) {
+            return current_uid == conversation.uid;
         });
     bool isInConv = conversation == conversations.end();
 
@@ -1922,25 +1941,17 @@ CppImpl::slotConversationRemoved(const std::string& uid)
 {
     // If contact is removed, go to welcome view
     auto* old_view = gtk_bin_get_child(GTK_BIN(widgets->frame_call));
-    lrc::api::conversation::Info current_item;
-    if (IS_CHAT_VIEW(old_view))
-        current_item = chat_view_get_conversation(CHAT_VIEW(old_view));
-    else if (IS_CURRENT_CALL_VIEW(old_view))
-        current_item = current_call_view_get_conversation(CURRENT_CALL_VIEW(old_view));
-    else if (IS_INCOMING_CALL_VIEW(old_view))
-        current_item = incoming_call_view_get_conversation(INCOMING_CALL_VIEW(old_view));
-    if (current_item.uid == uid)
+    if (getCurrentConversationUid(old_view) == uid)
         changeView(RING_WELCOME_VIEW_TYPE);
 }
 
 void
-CppImpl::slotShowChatView(const std::string& id, lrc::api::conversation::Info origin)
+CppImpl::slotShowChatView(const std::string& id, const lrc::api::conversation::Info& origin)
 {
     changeAccountSelection(id);
     // Show chat view if not in call (unless if it's the same conversation)
     auto* old_view = gtk_bin_get_child(GTK_BIN(widgets->frame_call));
-    lrc::api::conversation::Info current_item;
-    current_item.uid = "-1";
+    const lrc::api::conversation::Info* current_item = nullptr;
     if (IS_CHAT_VIEW(old_view))
         current_item = chat_view_get_conversation(CHAT_VIEW(old_view));
     // Do not show a conversation without any participants
@@ -1948,7 +1959,7 @@ CppImpl::slotShowChatView(const std::string& id, lrc::api::conversation::Info or
     auto firstContactUri = origin.participants.front();
     auto contactInfo = accountInfo_->contactModel->getContact(firstContactUri);
     // change view if necessary or just update temporary
-    if (current_item.uid != origin.uid) {
+    if (!current_item || current_item->uid != origin.uid) {
         changeView(CHAT_VIEW_TYPE, origin);
     } else {
         chat_view_update_temporary(CHAT_VIEW(old_view));
@@ -1956,7 +1967,7 @@ CppImpl::slotShowChatView(const std::string& id, lrc::api::conversation::Info or
 }
 
 void
-CppImpl::slotShowLeaveMessageView(lrc::api::conversation::Info conv)
+CppImpl::slotShowLeaveMessageView(const lrc::api::conversation::Info& conv)
 {
     auto* current_view = gtk_bin_get_child(GTK_BIN(widgets->frame_call));
     if (IS_INCOMING_CALL_VIEW(current_view)) {
@@ -1965,17 +1976,17 @@ CppImpl::slotShowLeaveMessageView(lrc::api::conversation::Info conv)
 }
 
 void
-CppImpl::slotShowCallView(const std::string& id, lrc::api::conversation::Info origin)
+CppImpl::slotShowCallView(const std::string& id, const lrc::api::conversation::Info& origin)
 {
     changeAccountSelection(id);
     // Change the view if we want a different view.
     auto* old_view = gtk_bin_get_child(GTK_BIN(widgets->frame_call));
 
-    lrc::api::conversation::Info current_item;
+    const lrc::api::conversation::Info* current_item = nullptr;
     if (IS_CURRENT_CALL_VIEW(old_view))
         current_item = current_call_view_get_conversation(CURRENT_CALL_VIEW(old_view));
 
-    if (current_item.uid != origin.uid)
+    if (!current_item || current_item->uid != origin.uid)
         changeView(CURRENT_CALL_VIEW_TYPE, origin);
 }
 
@@ -2088,7 +2099,7 @@ CppImpl::slotCloseInteraction(const std::string& accountId, const std::string& c
 }
 
 void
-CppImpl::slotShowIncomingCallView(const std::string& id, lrc::api::conversation::Info origin)
+CppImpl::slotShowIncomingCallView(const std::string& id, const lrc::api::conversation::Info& origin)
 {
     changeAccountSelection(id);
 
@@ -2101,12 +2112,28 @@ CppImpl::slotShowIncomingCallView(const std::string& id, lrc::api::conversation:
 void
 CppImpl::slotProfileUpdated(const std::string& id)
 {
+    normalizeAccountAvatars();
+
     auto currentIdx = gtk_combo_box_get_active(GTK_COMBO_BOX(widgets->combobox_account_selector));
     if (currentIdx == -1)
         currentIdx = 0; // If no account selected, select the first account
    refreshAccountSelectorWidget(currentIdx, id);
 }
 
+/**
+ * Bound the avatars of the accounts to the avatar size, whenever they may have
+ * been set from outside of the avatar settings: older profiles, imported
+ * accounts or profiles updated by the daemon. Only the accounts whose avatar
+ * is too large are re-encoded, in the background.
+ */
+void
+CppImpl::normalizeAccountAvatars()
+{
+    avatar_manipulation_normalize_account_avatars(lrc_->getAccountModel(),
+                                                  normalizeAvatarsCancellable_,
+                                                  nullptr);
+}
+
 }} // namespace <anonymous>::details
 
 void
@@ -298,16 +298,12 @@ ring_show_notification(RingNotifier* view, const std::string& icon,
     priv->cpp->notifications_.emplace(id, notification);
 
     // Draw icon
-    auto firstLetter = name.empty() ? "" : QString(QString(name.c_str()).at(0)).toStdString();  // NOTE best way to be compatible with UTF-8
-    auto default_avatar = Interfaces::PixbufManipulator().generateAvatar(firstLetter, uri);
-    auto photo = Interfaces::PixbufManipulator().scaleAndFrame(default_avatar.get(), QSize(50, 50));
-    if (!icon.empty()) {
-        QByteArray byteArray(icon.c_str(), icon.length());
-        QVariant avatar = Interfaces::PixbufManipulator().personPhoto(byteArray);
-        auto pixbuf_photo = Interfaces::PixbufManipulator().scaleAndFrame(avatar.value<std::shared_ptr<GdkPixbuf>>().get(), QSize(50, 50));
-        if (avatar.isValid()) {
-            photo = pixbuf_photo;
-        }
+    auto& pixbufManipulator = static_cast<Interfaces::PixbufManipulator&>(GlobalInstances::pixmapManipulator());
+    auto photo = pixbufManipulator.profilePhoto(icon, QSize(50, 50));
+    if (!photo) {
+        auto firstLetter = name.empty() ? "" : QString(QString(name.c_str()).at(0)).toStdString();  // NOTE best way to be compatible with UTF-8
+        auto default_avatar = pixbufManipulator.generateAvatar(firstLetter, uri);
+        photo = pixbufManipulator.scaleAndFrame(default_avatar.get(), QSize(50, 50));
     }
     notify_notification_set_image_from_pixbuf(notification.get(), photo.get());
 
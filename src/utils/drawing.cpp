@@ -22,6 +22,9 @@
 #include <gtk/gtk.h>
 #include <math.h>
 #include <algorithm>
+#include <map>
+#include <mutex>
+#include <tuple>
 
 static constexpr const char* MSG_COUNT_FONT        = "Sans";
 static constexpr int         MSG_COUNT_FONT_SIZE   = 12;
@@ -49,15 +52,14 @@ static constexpr GdkRGBA     COLOR_PALETTE[] = {{0.956862, 0.262745, 0.211764, 1
                                                 {0.474509, 0.333333, 0.282352, 1.0}, // red 120, green 84, blue 71, 1 (brown)
                                                 {0.376470, 0.490196, 0.545098, 1.0}};// red 95, green 124, blue 138, 1 (blue grey)
 
-GdkPixbuf *
-ring_draw_fallback_avatar(int size, const std::string& letter, const char color) {
+static GdkPixbuf *
+draw_fallback_avatar(int size, const std::string& letter, const GdkRGBA& bg_color) {
     cairo_surface_t *surface;
     cairo_t *cr;
 
     // Fill the background
     surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, size, size);
     cr = cairo_create(surface);
-    auto bg_color = COLOR_PALETTE[color % 16];
     cairo_set_source_rgb (cr, bg_color.red, bg_color.green, bg_color.blue);
     cairo_paint(cr);
 
@@ -72,23 +74,59 @@ ring_draw_fallback_avatar(int size, const std::string& letter, const char color)
         auto y = size/2-(extents.height/2 + extents.y_bearing);
         cairo_move_to(cr, x, y);
         cairo_show_text(cr, letter.c_str());
-    } else {
-        // Compose from fallback svg if no letter found
-        GError *error = nullptr;
-        auto* finalAvatar = gdk_pixbuf_get_from_surface(cairo_get_target(cr), 0, 0, size, size);
-        auto* fallbackavatar = gdk_pixbuf_new_from_resource_at_scale("/cx/ring/RingGnome/fallbackavatar", size, size, true, &error);
-        gdk_pixbuf_composite (fallbackavatar, finalAvatar, 0, 0, size, size, 0, 0, 1, 1, GDK_INTERP_BILINEAR, 0xff);
-
-        return finalAvatar;
     }
 
-
-    GdkPixbuf *pixbuf = gdk_pixbuf_get_from_surface(cairo_get_target(cr), 0, 0, size, size);
+    GdkPixbuf *pixbuf = gdk_pixbuf_get_from_surface(surface, 0, 0, size, size);
 
     /* free resources */
     cairo_destroy(cr);
     cairo_surface_destroy(surface);
 
+    if (letter.empty()) {
+        // Compose from fallback svg if no letter found
+        GError *error = nullptr;
+        auto* fallbackavatar = gdk_pixbuf_new_from_resource_at_scale("/cx/ring/RingGnome/fallbackavatar", size, size, true, &error);
+        if (fallbackavatar) {
+            gdk_pixbuf_composite (fallbackavatar, pixbuf, 0, 0, size, size, 0, 0, 1, 1, GDK_INTERP_BILINEAR, 0xff);
+            g_object_unref(fallbackavatar);
+        } else {
+            g_warning("could not load fallback avatar: %s", error->message);
+            g_clear_error(&error);
+        }
+    }
+
+    return pixbuf;
+}
+
+GdkPixbuf *
+ring_draw_fallback_avatar(int size, const std::string& letter, const char color) {
+    /* Only 16 colours, a few sizes and the first letter of the names are
+     * drawn, so the avatars are drawn once and shared. They are never
+     * modified once cached: callers compose them into new pixbufs. */
+    static constexpr std::size_t MAX_CACHED_AVATARS = 1024;
+    static std::mutex cache_mutex;
+    static std::map<std::tuple<int, std::string, int>, GdkPixbuf*> cache;
+
+    auto color_index = static_cast<unsigned char>(color) % 16;
+    auto key = std::make_tuple(size, letter, color_index);
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    auto it = cache.find(key);
+    if (it != cache.end())
+        return GDK_PIXBUF(g_object_ref(it->second));
+
+    auto pixbuf = draw_fallback_avatar(size, letter, COLOR_PALETTE[color_index]);
+    if (!pixbuf)
+        return nullptr;
+
+    if (cache.size() >= MAX_CACHED_AVATARS) {
+        // letters can be any character, do not let unusual names grow the cache forever
+        for (auto& avatar : cache)
+            g_object_unref(avatar.second);
+        cache.clear();
+    }
+    cache.emplace(std::move(key), GDK_PIXBUF(g_object_ref(pixbuf)));
+
     return pixbuf;
 }
 
@@ -129,62 +167,6 @@ ring_draw_conference_avatar(int size) {
     return pixbuf;
 }
 
-GdkPixbuf *
-ring_frame_avatar(GdkPixbuf *avatar) {
-
-    auto w = gdk_pixbuf_get_width(avatar);
-    auto h = gdk_pixbuf_get_height(avatar);
-    auto crop_size = std::min(h, w);
-    auto new_size = std::max(h, w);
-    auto scale = (double)new_size/(double)crop_size;
-    GdkPixbuf *crop_avatar = gdk_pixbuf_new (
-                               gdk_pixbuf_get_colorspace (avatar),
-                               gdk_pixbuf_get_has_alpha (avatar),
-                               gdk_pixbuf_get_bits_per_sample (avatar),
-                               new_size, new_size);
-    gdk_pixbuf_scale (avatar, crop_avatar, 0, 0, new_size, new_size,
-                      (w/2)-(new_size/2), (h/2)-(new_size/2), scale, scale,
-                      GDK_INTERP_BILINEAR);
-    auto extra_space = 10;
-    auto offset = extra_space/2;
-    auto s_surface = new_size + extra_space;
-    cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, s_surface, s_surface);
-    cairo_t *cr = cairo_create(surface);
-
-    cairo_set_source_rgba(cr, 0, 0, 0, 0);
-    cairo_rectangle(cr, 0, 0, s_surface, s_surface);
-    cairo_fill(cr);
-
-    double radius = new_size/2;
-    double degrees = M_PI / 180.0;
-
-    // create the square path with ronded corners
-    cairo_new_sub_path (cr);
-    cairo_arc (cr, offset + new_size - radius, offset + radius, radius, -90 * degrees, 0 * degrees);
-    cairo_arc (cr, offset + new_size - radius, offset + new_size - radius, radius, 0 * degrees, 90 * degrees);
-    cairo_arc (cr, offset + radius, offset + new_size - radius, radius, 90 * degrees, 180 * degrees);
-    cairo_arc (cr, offset + radius, offset + radius, radius, 180 * degrees, 270 * degrees);
-    cairo_close_path (cr);
-
-    // in case the image has alpha, we want to first set the background of the part inside the
-    // blue frame to white; otherwise the resulting image will show whatever is in the background,
-    // which can be weird in certain cases (eg: the image displayed over a video)
-    cairo_set_source_rgba(cr, 1, 1, 1, 1);
-    cairo_fill_preserve(cr);
-
-    // now draw the image over this black square
-    gdk_cairo_set_source_pixbuf(cr, crop_avatar, offset, offset);
-    cairo_fill_preserve(cr);
-
-    auto pixbuf = gdk_pixbuf_get_from_surface(surface, 0, 0, s_surface, s_surface);
-
-    /* free resources */
-    cairo_destroy(cr);
-    cairo_surface_destroy(surface);
-
-    return pixbuf;
-}
-
 static void
 create_rounded_rectangle_path(cairo_t *cr, double corner_radius, double x, double y, double w, double h)
 {
@@ -200,25 +182,11 @@ create_rounded_rectangle_path(cairo_t *cr, double corner_radius, double x, doubl
 }
 
 /**
- * Draws the presence icon in the top right corner of the given image.
+ * Draws the presence icon in the bottom right corner of a w x h image.
  */
-GdkPixbuf *
-ring_draw_status(const GdkPixbuf *avatar, IconStatus status) {
-    if (status == IconStatus::INVALID) {
-        // simply return a copy of the original pixbuf
-        return gdk_pixbuf_copy(avatar);
-    }
-
-    int w = gdk_pixbuf_get_width(avatar);
-    int h = gdk_pixbuf_get_height(avatar);
-    cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, w, h);
-    cairo_t *cr = cairo_create(surface);
-    cairo_surface_destroy(surface);
-
-    /* draw original image */
-    gdk_cairo_set_source_pixbuf(cr, avatar, 0, 0);
-    cairo_paint(cr);
-
+static void
+draw_status(cairo_t *cr, int w, int h, IconStatus status)
+{
     /* draw rounded rectangle, with 3 pixel border
      * ie: 6 pixels higher, 6 pixels wider */
     int border_width = 5;
@@ -256,35 +224,14 @@ ring_draw_status(const GdkPixbuf *avatar, IconStatus status) {
     cairo_set_source_rgb(cr, 1, 1, 1);
     cairo_set_line_width(cr, 1.2);
     cairo_stroke(cr);
-
-    GdkPixbuf *pixbuf = gdk_pixbuf_get_from_surface(surface, 0, 0, w, h);
-
-    /* free resources */
-    cairo_destroy(cr);
-
-    return pixbuf;
 }
 
 /**
- * Draws the unread message count in the bottom right corner of the given image.
- * In the case that the count is less than or equal to 0, nothing is drawn.
+ * Draws the unread message count in the top right corner of an image w wide.
  */
-GdkPixbuf *
-ring_draw_unread_messages(const GdkPixbuf *avatar, int unread_count) {
-    if (unread_count <= 0) {
-        // simply return a copy of the original pixbuf
-        return gdk_pixbuf_copy(avatar);
-    }
-    int w = gdk_pixbuf_get_width(avatar);
-    int h = gdk_pixbuf_get_height(avatar);
-    cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, w, h);
-    cairo_t *cr = cairo_create(surface);
-    cairo_surface_destroy(surface);
-
-    /* draw original image */
-    gdk_cairo_set_source_pixbuf(cr, avatar, 0, 0);
-    cairo_paint(cr);
-
+static void
+draw_unread_messages(cairo_t *cr, int w, int unread_count)
+{
     /* make text */
     char *text = g_strdup_printf("%s", unread_count > 9 ? "9+" : std::to_string(unread_count).c_str());
     cairo_text_extents_t extents;
@@ -314,12 +261,53 @@ ring_draw_unread_messages(const GdkPixbuf *avatar, int unread_count) {
     cairo_move_to (cr, w - extents.width-border_width, extents.height + border_width );
     cairo_set_source_rgb(cr, MSG_COUNT_FONT_COLOUR.red, MSG_COUNT_FONT_COLOUR.blue, MSG_COUNT_FONT_COLOUR.green);
     cairo_show_text (cr, text);
+    g_free(text);
+}
 
-    GdkPixbuf *pixbuf = gdk_pixbuf_get_from_surface(surface, 0, 0, w, h);
+/**
+ * Draws the photo in a round frame, then the presence icon unless status is
+ * INVALID and the unread message count if it is positive, in a single
+ * size x size surface. The photo is scaled to cover the frame, keeping its
+ * aspect ratio.
+ */
+cairo_surface_t *
+ring_draw_avatar(const GdkPixbuf *photo, int size, IconStatus status, int unread_count)
+{
+    cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, size, size);
+    cairo_t *cr = cairo_create(surface);
+
+    auto extra_space = 10;
+    auto offset = extra_space/2;
+    double photo_size = std::max(1, size - extra_space);
+    double radius = photo_size/2;
+
+    cairo_save(cr);
+    cairo_arc(cr, offset + radius, offset + radius, radius, 0, 2 * M_PI);
+
+    // in case the image has alpha, we want to first set the background of the part inside the
+    // frame to white; otherwise the resulting image will show whatever is in the background,
+    // which can be weird in certain cases (eg: the image displayed over a video)
+    cairo_set_source_rgba(cr, 1, 1, 1, 1);
+    cairo_fill_preserve(cr);
+    cairo_clip(cr);
+
+    // now draw the image, centered, with its smallest side filling the frame
+    int w = gdk_pixbuf_get_width(photo);
+    int h = gdk_pixbuf_get_height(photo);
+    auto scale = photo_size / std::min(w, h);
+    cairo_translate(cr, offset + (photo_size - w * scale) / 2, offset + (photo_size - h * scale) / 2);
+    cairo_scale(cr, scale, scale);
+    gdk_cairo_set_source_pixbuf(cr, photo, 0, 0);
+    cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_GOOD);
+    cairo_paint(cr);
+    cairo_restore(cr);
+
+    if (status != IconStatus::INVALID)
+        draw_status(cr, size, size, status);
+    if (unread_count > 0)
+        draw_unread_messages(cr, size, unread_count);
 
-    /* free resources */
     cairo_destroy(cr);
-    g_free(text);
 
-    return pixbuf;
+    return surface;
 }
@@ -23,14 +23,11 @@
 #include <gtk/gtk.h>
 #include <string>
 
+/* returns a new reference to a cached pixbuf, which must not be modified */
 GdkPixbuf *ring_draw_fallback_avatar(int size, const std::string& letter, const char color = 0);
 
 GdkPixbuf *ring_draw_conference_avatar(int size);
 
-GdkPixbuf *ring_frame_avatar(GdkPixbuf *avatar);
-
-GdkPixbuf *ring_draw_unread_messages(const GdkPixbuf *avatar, int unread_count);
-
 
 enum class IconStatus {
     ABSENT,
@@ -40,6 +37,8 @@ enum class IconStatus {
     CONNECTED,
     INVALID
 };
-GdkPixbuf *ring_draw_status(const GdkPixbuf *avatar, IconStatus status);
+
+/* frames the photo and draws the status and unread count in a single pass */
+cairo_surface_t *ring_draw_avatar(const GdkPixbuf *photo, int size, IconStatus status, int unread_count);
 
 #endif /* _DRAWING */
@@ -0,0 +1,222 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "jsonwriter.h"
+
+void
+JsonWriter::clear()
+{
+    buffer_.clear();
+    needComma_ = false;
+}
+
+void
+JsonWriter::separator()
+{
+    if (needComma_)
+        buffer_ += ',';
+    needComma_ = true;
+}
+
+void
+JsonWriter::beginObject()
+{
+    separator();
+    buffer_ += '{';
+    needComma_ = false;
+}
+
+void
+JsonWriter::endObject()
+{
+    buffer_ += '}';
+    needComma_ = true;
+}
+
+void
+JsonWriter::beginArray()
+{
+    separator();
+    buffer_ += '[';
+    needComma_ = false;
+}
+
+void
+JsonWriter::endArray()
+{
+    buffer_ += ']';
+    needComma_ = true;
+}
+
+void
+JsonWriter::key(JsonLiteral name)
+{
+    separator();
+    buffer_ += '"';
+    buffer_.append(name.data, name.size);
+    buffer_ += "\":";
+    needComma_ = false;
+}
+
+void
+JsonWriter::literal(JsonLiteral str)
+{
+    separator();
+    buffer_ += '"';
+    buffer_.append(str.data, str.size);
+    buffer_ += '"';
+}
+
+void
+JsonWriter::value(const char* str, std::size_t size)
+{
+    separator();
+    buffer_ += '"';
+
+    const gchar* end = str + size;
+    while (str < end) {
+        const gchar* valid_end;
+        g_utf8_validate(str, end - str, &valid_end);
+        appendEscaped(str, valid_end - str);
+        if (valid_end == end)
+            break;
+        /* skip the invalid byte */
+        buffer_ += "\xEF\xBF\xBD";
+        str = valid_end + 1;
+    }
+
+    buffer_ += '"';
+}
+
+void
+JsonWriter::value(gint64 number)
+{
+    separator();
+    appendNumber(number);
+}
+
+void
+JsonWriter::boolean(bool value)
+{
+    separator();
+    buffer_ += value ? "true" : "false";
+}
+
+void
+JsonWriter::valueAsString(gint64 number)
+{
+    separator();
+    buffer_ += '"';
+    appendNumber(number);
+    buffer_ += '"';
+}
+
+void
+JsonWriter::valueAsString(guint64 number)
+{
+    separator();
+    buffer_ += '"';
+    appendNumber(number);
+    buffer_ += '"';
+}
+
+void
+JsonWriter::serialized(const std::string& json)
+{
+    separator();
+    buffer_ += json;
+}
+
+void
+JsonWriter::raw(JsonLiteral str)
+{
+    buffer_.append(str.data, str.size);
+}
+
+void
+JsonWriter::appendEscaped(const char* str, std::size_t size)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    /* copy runs of characters which do not need escaping at once */
+    std::size_t run = 0;
+    for (std::size_t i = 0; i < size; ++i) {
+        auto c = static_cast<guchar>(str[i]);
+        const char* escape = nullptr;
+        char unicode_escape[7];
+
+        if (c == '"') {
+            escape = "\\\"";
+        } else if (c == '\\') {
+            escape = "\\\\";
+        } else if (c == '\n') {
+            escape = "\\n";
+        } else if (c == '\r') {
+            escape = "\\r";
+        } else if (c == '\t') {
+            escape = "\\t";
+        } else if (c < 0x20) {
+            unicode_escape[0] = '\\';
+            unicode_escape[1] = 'u';
+            unicode_escape[2] = '0';
+            unicode_escape[3] = '0';
+            unicode_escape[4] = hex[c >> 4];
+            unicode_escape[5] = hex[c & 0xf];
+            unicode_escape[6] = '\0';
+            escape = unicode_escape;
+        } else if (c == 0xe2 && i + 2 < size && static_cast<guchar>(str[i + 1]) == 0x80
+                   && (static_cast<guchar>(str[i + 2]) & 0xfe) == 0xa8) {
+            /* U+2028 LINE SEPARATOR and U+2029 PARAGRAPH SEPARATOR */
+            escape = static_cast<guchar>(str[i + 2]) == 0xa8 ? "\\u2028" : "\\u2029";
+            buffer_.append(str + run, i - run);
+            buffer_ += escape;
+            i += 2;
+            run = i + 1;
+            continue;
+        } else {
+            continue;
+        }
+
+        buffer_.append(str + run, i - run);
+        buffer_ += escape;
+        run = i + 1;
+    }
+    buffer_.append(str + run, size - run);
+}
+
+void
+JsonWriter::appendNumber(gint64 number)
+{
+    if (number < 0)
+        buffer_ += '-';
+    /* work on the absolute value as unsigned so G_MININT64 does not overflow */
+    appendNumber(number < 0 ? ~static_cast<guint64>(number) + 1 : static_cast<guint64>(number));
+}
+
+void
+JsonWriter::appendNumber(guint64 number)
+{
+    char digits[20];
+    auto pos = sizeof(digits);
+    do {
+        digits[--pos] = '0' + number % 10;
+        number /= 10;
+    } while (number);
+
+    buffer_.append(digits + pos, sizeof(digits) - pos);
+}
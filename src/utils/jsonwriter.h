@@ -0,0 +1,88 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+#include <cstddef>
+#include <string>
+
+/**
+ * String literal with its length known at compile time, used for JSON keys
+ * and for constant string values which do not need escaping.
+ */
+struct JsonLiteral
+{
+    const char* data;
+    std::size_t size;
+
+    template<std::size_t N>
+    constexpr JsonLiteral(const char (&str)[N]) : data(str), size(N - 1) {}
+};
+
+/**
+ * Compact JSON writer appending to a UTF-8 buffer which is reused between
+ * documents: clear() keeps the allocated capacity. Separators are inserted
+ * automatically, and strings are escaped while being copied into the buffer
+ * so no intermediate string is built.
+ *
+ * The output can be passed to webkit_web_view_run_javascript(): U+2028 and
+ * U+2029, which are not allowed in javascript string literals, are escaped,
+ * and invalid UTF-8 sequences are replaced by U+FFFD.
+ */
+class JsonWriter
+{
+public:
+    void clear();
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+
+    void key(JsonLiteral name);
+
+    /* writes a string which does not need escaping */
+    void literal(JsonLiteral str);
+    void value(const char* str, std::size_t size);
+    void value(const std::string& str) { value(str.data(), str.size()); }
+    void value(gint64 number);
+    void boolean(bool value);
+    /* writes number as a JSON string, e.g. interaction ids */
+    void valueAsString(gint64 number);
+    void valueAsString(guint64 number);
+
+    /* writes a value which is already serialized JSON */
+    void serialized(const std::string& json);
+
+    /* appends str verbatim, e.g. javascript around the JSON document */
+    void raw(JsonLiteral str);
+
+    const std::string& str() const { return buffer_; }
+    const char* c_str() const { return buffer_.c_str(); }
+
+private:
+    void separator();
+    void appendEscaped(const char* str, std::size_t size);
+    void appendNumber(gint64 number);
+    void appendNumber(guint64 number);
+
+    std::string buffer_;
+    bool needComma_ = false;
+};
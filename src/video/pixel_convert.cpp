@@ -0,0 +1,163 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#include "pixel_convert.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define PIXEL_CONVERT_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PIXEL_CONVERT_NEON 1
+#include <arm_neon.h>
+#endif
+
+using ConvertFunc = void (*)(const guint8*, guint8*, gsize);
+
+static void
+convert_scalar(const guint8 *src, guint8 *dst, gsize pixel_count)
+{
+    for (gsize i = 0; i < pixel_count; ++i, src += 4, dst += 3) {
+        dst[0] = src[2];
+        dst[1] = src[1];
+        dst[2] = src[0];
+    }
+}
+
+#ifdef PIXEL_CONVERT_X86
+
+/* BGRA BGRA BGRA BGRA -> RGB RGB RGB RGB, the last 4 bytes are zeroed */
+#define BGRA_TO_RGB_MASK 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1
+
+__attribute__((target("ssse3"))) static void
+convert_ssse3(const guint8 *src, guint8 *dst, gsize pixel_count)
+{
+    const __m128i mask = _mm_setr_epi8(BGRA_TO_RGB_MASK);
+
+    /* each 16 byte store only has 12 valid bytes, the 4 extra bytes are
+     * overwritten by the next store; stop early enough so the last store
+     * stays within dst and let the scalar loop handle the tail */
+    gsize i = 0;
+    for (; i + 6 <= pixel_count; i += 4, src += 16, dst += 12) {
+        __m128i px = _mm_loadu_si128((const __m128i*)src);
+        _mm_storeu_si128((__m128i*)dst, _mm_shuffle_epi8(px, mask));
+    }
+    convert_scalar(src, dst, pixel_count - i);
+}
+
+__attribute__((target("avx2"))) static void
+convert_avx2(const guint8 *src, guint8 *dst, gsize pixel_count)
+{
+    /* the shuffle works on each 128 bit lane independently */
+    const __m256i mask = _mm256_setr_epi8(BGRA_TO_RGB_MASK, BGRA_TO_RGB_MASK);
+
+    gsize i = 0;
+    for (; i + 10 <= pixel_count; i += 8, src += 32, dst += 24) {
+        __m256i px = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)src), mask);
+        _mm_storeu_si128((__m128i*)dst, _mm256_castsi256_si128(px));
+        _mm_storeu_si128((__m128i*)(dst + 12), _mm256_extracti128_si256(px, 1));
+    }
+    convert_scalar(src, dst, pixel_count - i);
+}
+
+#undef BGRA_TO_RGB_MASK
+
+#endif /* PIXEL_CONVERT_X86 */
+
+#ifdef PIXEL_CONVERT_NEON
+
+static void
+convert_neon(const guint8 *src, guint8 *dst, gsize pixel_count)
+{
+    gsize i = 0;
+    for (; i + 16 <= pixel_count; i += 16, src += 64, dst += 48) {
+        uint8x16x4_t bgra = vld4q_u8(src);
+        uint8x16x3_t rgb;
+        rgb.val[0] = bgra.val[2];
+        rgb.val[1] = bgra.val[1];
+        rgb.val[2] = bgra.val[0];
+        vst3q_u8(dst, rgb);
+    }
+    convert_scalar(src, dst, pixel_count - i);
+}
+
+#endif /* PIXEL_CONVERT_NEON */
+
+static ConvertFunc
+select_implementation()
+{
+#if defined(PIXEL_CONVERT_NEON)
+    return convert_neon;
+#elif defined(PIXEL_CONVERT_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return convert_avx2;
+    if (__builtin_cpu_supports("ssse3"))
+        return convert_ssse3;
+    return convert_scalar;
+#else
+    return convert_scalar;
+#endif
+}
+
+void
+pixel_convert_bgra_to_rgb(const guint8 *src, guint8 *dst, gsize pixel_count)
+{
+    /* thread-safe one time initialization */
+    static const ConvertFunc convert = select_implementation();
+    convert(src, dst, pixel_count);
+}
+
+/* maximum number of samples taken along each axis for a destination pixel,
+ * the step is rounded up so that it is never exceeded */
+static constexpr gint DOWNSCALE_MAX_SAMPLES = 4;
+
+void
+pixel_convert_downscale_bgra(const guint8 *src, gint src_width, gint src_height, gint src_stride,
+                             guint8 *dst, gint dst_width, gint dst_height)
+{
+    for (gint y = 0; y < dst_height; ++y) {
+        gint y0 = (gint)((gint64)y * src_height / dst_height);
+        gint y1 = MAX(y0 + 1, (gint)((gint64)(y + 1) * src_height / dst_height));
+        gint y_step = (y1 - y0 + DOWNSCALE_MAX_SAMPLES - 1) / DOWNSCALE_MAX_SAMPLES;
+
+        for (gint x = 0; x < dst_width; ++x, dst += 4) {
+            gint x0 = (gint)((gint64)x * src_width / dst_width);
+            gint x1 = MAX(x0 + 1, (gint)((gint64)(x + 1) * src_width / dst_width));
+            gint x_step = (x1 - x0 + DOWNSCALE_MAX_SAMPLES - 1) / DOWNSCALE_MAX_SAMPLES;
+
+            guint sum[4] = { 0, 0, 0, 0 };
+            guint samples = 0;
+            for (gint sy = y0; sy < y1; sy += y_step) {
+                const guint8 *row = src + (gsize)sy * src_stride;
+                for (gint sx = x0; sx < x1; sx += x_step) {
+                    const guint8 *px = row + (gsize)sx * 4;
+                    sum[0] += px[0];
+                    sum[1] += px[1];
+                    sum[2] += px[2];
+                    sum[3] += px[3];
+                    ++samples;
+                }
+            }
+
+            for (int c = 0; c < 4; ++c)
+                dst[c] = (guint8)(sum[c] / samples);
+        }
+    }
+}
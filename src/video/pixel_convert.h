@@ -0,0 +1,43 @@
+/*
+ *  Copyright (C) 2018 Savoir-faire Linux Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA.
+ */
+
+#ifndef _PIXEL_CONVERT_H
+#define _PIXEL_CONVERT_H
+
+#include <glib.h>
+
+/**
+ * Converts pixel_count packed BGRA pixels from src into packed RGB pixels in
+ * dst (which must hold 3 * pixel_count bytes), dropping the alpha channel.
+ *
+ * The fastest implementation supported by the CPU (AVX2, SSSE3 or NEON) is
+ * selected on first use; a scalar loop is used otherwise.
+ */
+void pixel_convert_bgra_to_rgb(const guint8 *src, guint8 *dst, gsize pixel_count);
+
+/**
+ * Downscales a BGRA image of src_width x src_height pixels, with rows
+ * src_stride bytes apart, into dst, a packed BGRA image of dst_width x
+ * dst_height pixels. Each destination pixel is the average of up to 4x4
+ * pixels sampled from the source area it covers, which keeps the cost bounded
+ * by the destination size.
+ */
+void pixel_convert_downscale_bgra(const guint8 *src, gint src_width, gint src_height, gint src_stride,
+                                  guint8 *dst, gint dst_width, gint dst_height);
+
+#endif /* _PIXEL_CONVERT_H */
@@ -30,25 +30,23 @@
 #include <QtCore/QUrl>
 #include "../defines.h"
 #include <stdlib.h>
+#include <string.h>
+#include <algorithm>
 #include <atomic>
 #include <mutex>
+#include <vector>
 #include <call.h>
 #include "xrectsel.h"
+#include "pixel_convert.h"
 #include <smartinfohub.h>
 
 static constexpr int VIDEO_LOCAL_SIZE            = 150;
 static constexpr int VIDEO_LOCAL_OPACITY_DEFAULT = 255; /* out of 255 */
 static constexpr const char* JOIN_CALL_KEY = "call_data";
 
-/* check video frame queues at this rate;
- * use 30 ms (about 30 fps) since we don't expect to
- * receive video frames faster than that */
-static constexpr int FRAME_RATE_PERIOD           = 30;
-
 enum SnapshotStatus {
     NOTHING,
-    HAS_TO_TAKE_ONE,
-    HAS_A_NEW_ONE
+    HAS_TO_TAKE_ONE
 };
 
 struct _VideoWidgetClass {
@@ -72,24 +70,44 @@ struct _VideoWidgetPrivate {
     /* local peer data */
     VideoWidgetRenderer     *local;
 
-    guint                    frame_timeout_source;
-
-    /* new renderers should be put into the queue for processing by a g_timeout
-     * function whose id should be saved into renderer_timeout_source;
-     * this way when the VideoWidget object is destroyed, we do not try
-     * to process any new renderers by stoping the g_timeout function.
+    /* dispatched from the main loop whenever one of the renderers has a
+     * frame which hasn't been displayed yet or when a new renderer was pushed
+     * into new_renderer_queue (see VideoFrameSource); this way when the
+     * VideoWidget object is destroyed, we do not try to process any new
+     * renderers once the source is destroyed.
      */
-    guint                    renderer_timeout_source;
+    GSource                 *frame_source;
     GAsyncQueue             *new_renderer_queue;
 
     GtkWidget               *popup_menu;
+
+    /* the frame to snapshot is copied into this buffer, which is reused for
+     * every snapshot, and then converted on a worker thread; snapshot_pending
+     * is set while the worker owns the buffer */
+    guint8                  *snapshot_buffer;
+    gsize                    snapshot_buffer_size;
+    bool                     snapshot_pending;
 };
 
+typedef struct {
+    const guint8 *bgra;
+    gint          width;
+    gint          height;
+} SnapshotJob;
+
 struct _VideoWidgetRenderer {
     VideoRendererType        type;
     ClutterActor            *actor;
     ClutterAction           *drag_action;
     Video::Renderer         *renderer;
+
+    /* persistent image the frames are uploaded into; it is only re-created
+     * when the frame size changes, otherwise each new frame is written into
+     * the existing texture in place */
+    ClutterContent          *image;
+    gint                     image_width;
+    gint                     image_height;
+
     GdkPixbuf               *snapshot;
     std::mutex               run_mutex;
     bool                     running;
@@ -102,10 +120,54 @@ struct _VideoWidgetRenderer {
      */
     std::atomic_bool         show_black_frame;
     std::atomic_bool         pause_rendering;
+
+    /* frame_seq is incremented by the renderer thread each time a new frame
+     * is available; rendered_seq is the last sequence number which was
+     * uploaded to the actor and is only accessed from the main thread */
+    std::atomic<guint64>     frame_seq;
+    guint64                  rendered_seq;
+
+    /* statistics; frames_received and last_frame_time are written by the
+     * renderer thread, the rest only by the main thread */
+    std::atomic<guint64>     frames_received;
+    std::atomic<gint64>      last_frame_time;
+    VideoWidgetStats         stats;
+
+    /* size, in pixels, of the area the actor is displayed in; when set, the
+     * frames are downscaled to fit it on a worker thread before being
+     * uploaded, instead of uploading the full resolution frame. Only accessed
+     * by the main thread, the worker gets a copy (see DownscaleJob) */
+    gint                     target_width;
+    gint                     target_height;
+
+    /* downscaled frame written by the worker; it is only accessed by the main
+     * thread once downscale_pending is cleared. If the renderer is freed while
+     * a downscale is pending, the free is deferred until the worker is done */
+    guint8                  *scaled_buffer;
+    gsize                    scaled_buffer_size;
+    gint                     scaled_width;
+    gint                     scaled_height;
+    guint64                  scaled_seq; ///< frame_seq when the worker read the frame
+    /* incremented each time a black frame is shown, so that a downscale
+     * started before the renderer stopped isn't displayed over it */
+    guint                    black_generation;
+    bool                     downscale_pending;
+    bool                     free_pending;
+
     QMetaObject::Connection  render_stop;
     QMetaObject::Connection  render_start;
+    QMetaObject::Connection  render_update;
 };
 
+/* GSource which becomes ready as soon as one of the renderers of the widget
+ * has something new to display or a new renderer is queued; the renderer
+ * threads wake up the main context when a frame arrives, so no polling is done
+ * while the video is static or while there is no video at all */
+typedef struct {
+    GSource      source;
+    VideoWidget *self;
+} VideoFrameSource;
+
 G_DEFINE_TYPE_WITH_PRIVATE(VideoWidget, video_widget, GTK_CLUTTER_TYPE_EMBED);
 
 #define VIDEO_WIDGET_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), VIDEO_WIDGET_TYPE, VideoWidgetPrivate))
@@ -114,7 +176,7 @@ G_DEFINE_TYPE_WITH_PRIVATE(VideoWidget, video_widget, GTK_CLUTTER_TYPE_EMBED);
 static gboolean check_frame_queue              (VideoWidget *);
 static void     renderer_stop                  (VideoWidgetRenderer *);
 static void     renderer_start                 (VideoWidgetRenderer *);
-static gboolean check_renderer_queue           (VideoWidget *);
+static void     check_renderer_queue           (VideoWidget *);
 static void     free_video_widget_renderer     (VideoWidgetRenderer *);
 static void     video_widget_add_renderer      (VideoWidget *, VideoWidgetRenderer *);
 
@@ -140,14 +202,10 @@ video_widget_dispose(GObject *object)
 
     /* dispose may be called multiple times, make sure
      * not to call g_source_remove more than once */
-    if (priv->frame_timeout_source) {
-        g_source_remove(priv->frame_timeout_source);
-        priv->frame_timeout_source = 0;
-    }
-
-    if (priv->renderer_timeout_source) {
-        g_source_remove(priv->renderer_timeout_source);
-        priv->renderer_timeout_source = 0;
+    if (priv->frame_source) {
+        g_source_destroy(priv->frame_source);
+        g_source_unref(priv->frame_source);
+        priv->frame_source = nullptr;
     }
 
     if (priv->new_renderer_queue) {
@@ -174,6 +232,7 @@ video_widget_finalize(GObject *object)
 
     free_video_widget_renderer(priv->local);
     free_video_widget_renderer(priv->remote);
+    g_free(priv->snapshot_buffer);
 
     G_OBJECT_CLASS(video_widget_parent_class)->finalize(object);
 }
@@ -218,6 +277,11 @@ on_allocation_changed(ClutterActor *video_area, G_GNUC_UNUSED GParamSpec *pspec,
     gfloat actor_w = clutter_actor_box_get_width(&actor_box);
     gfloat actor_h = clutter_actor_box_get_height(&actor_box);
 
+    /* the local preview is small, downscale its frames to its size */
+    auto scale_factor = gtk_widget_get_scale_factor(GTK_WIDGET(self));
+    priv->local->target_width = (gint)(actor_w * scale_factor);
+    priv->local->target_height = (gint)(actor_h * scale_factor);
+
     ClutterActorBox area_box;
     clutter_actor_get_allocation_box(video_area, &area_box);
     gfloat area_w = clutter_actor_box_get_width(&area_box);
@@ -283,6 +347,58 @@ on_drag_end(G_GNUC_UNUSED ClutterDragAction   *action,
 }
 
 
+static gboolean
+renderer_has_new_frame(VideoWidgetRenderer *renderer)
+{
+    if (!renderer || renderer->pause_rendering)
+        return FALSE;
+
+    if (renderer->show_black_frame)
+        return TRUE;
+
+    /* on_frame_downscaled() wakes us up if a frame arrived in the meantime */
+    if (renderer->downscale_pending)
+        return FALSE;
+
+    return renderer->frame_seq != renderer->rendered_seq;
+}
+
+static gboolean
+video_frame_source_prepare(GSource *source, gint *timeout)
+{
+    auto self = ((VideoFrameSource *)source)->self;
+    VideoWidgetPrivate *priv = VIDEO_WIDGET_GET_PRIVATE(self);
+
+    /* no timeout: we are woken up by the renderers */
+    *timeout = -1;
+
+    return renderer_has_new_frame(priv->local)
+        || renderer_has_new_frame(priv->remote)
+        || (priv->new_renderer_queue && g_async_queue_length(priv->new_renderer_queue) > 0);
+}
+
+static gboolean
+video_frame_source_check(GSource *source)
+{
+    gint timeout;
+    return video_frame_source_prepare(source, &timeout);
+}
+
+static gboolean
+video_frame_source_dispatch(G_GNUC_UNUSED GSource *source, GSourceFunc callback, gpointer user_data)
+{
+    return callback ? callback(user_data) : G_SOURCE_REMOVE;
+}
+
+static GSourceFuncs video_frame_source_funcs = {
+    video_frame_source_prepare,
+    video_frame_source_check,
+    video_frame_source_dispatch,
+    nullptr,
+    nullptr,
+    nullptr
+};
+
 /*
  * video_widget_init()
  *
@@ -344,26 +460,21 @@ video_widget_init(VideoWidget *self)
     /* make sure the actor stays within the bounds of the stage */
     g_signal_connect(stage, "notify::allocation", G_CALLBACK(on_allocation_changed), self);
 
-    /* Init the timeout source which will check the for new frames.
+    /* Init the source which will display new frames as they arrive.
      * The priority must be lower than GTK drawing events
-     * (G_PRIORITY_HIGH_IDLE + 20) so that this timeout source doesn't choke
-     * the main loop on slower machines.
+     * (G_PRIORITY_HIGH_IDLE + 20) so that this source doesn't choke
+     * the main loop on slower machines. The uploaded frames are then painted
+     * by the stage on its next frame clock tick.
      */
-    priv->frame_timeout_source = g_timeout_add_full(G_PRIORITY_DEFAULT_IDLE,
-                                                    FRAME_RATE_PERIOD,
-                                                    (GSourceFunc)check_frame_queue,
-                                                    self,
-                                                    NULL);
-
-    /* init new renderer queue */
+    priv->frame_source = g_source_new(&video_frame_source_funcs, sizeof(VideoFrameSource));
+    ((VideoFrameSource *)priv->frame_source)->self = self;
+    g_source_set_priority(priv->frame_source, G_PRIORITY_DEFAULT_IDLE);
+    g_source_set_callback(priv->frame_source, (GSourceFunc)check_frame_queue, self, NULL);
+    g_source_attach(priv->frame_source, NULL);
+
+    /* init new renderer queue; it is processed by the frame source, which is
+     * woken up when a new renderer is pushed */
     priv->new_renderer_queue = g_async_queue_new_full((GDestroyNotify)free_video_widget_renderer);
-    /* check new render every 30 ms (30ms is "fast enough");
-     * we don't use an idle function so it doesn't consume cpu needlessly */
-    priv->renderer_timeout_source= g_timeout_add_full(G_PRIORITY_DEFAULT_IDLE,
-                                                      30,
-                                                      (GSourceFunc)check_renderer_queue,
-                                                      self,
-                                                      NULL);
 
 
     /* drag & drop files as video sources */
@@ -634,14 +745,367 @@ free_pixels(guchar *pixels, gpointer)
 }
 
 static void
-clutter_render_image(VideoWidgetRenderer* wg_renderer)
+record_render_time(VideoWidgetRenderer* wg_renderer, gint64 start_time)
+{
+    auto& stats = wg_renderer->stats;
+    auto elapsed = (guint64)(g_get_monotonic_time() - start_time);
+    stats.render_time_us += elapsed;
+    stats.max_render_time_us = MAX(stats.max_render_time_us, elapsed);
+}
+
+/* upper bounds, in ms, of the frame latency histogram buckets; the last bucket
+ * holds everything above the previous bound */
+static const guint video_widget_latency_bucket_ms[VIDEO_WIDGET_LATENCY_BUCKETS] = {
+    5, 10, 17, 33, 50, VIDEO_WIDGET_LATENCY_MAX_MS, VIDEO_WIDGET_LATENCY_UNBOUNDED
+};
+
+static void
+record_rendered_frame(VideoWidgetRenderer* wg_renderer)
+{
+    auto& stats = wg_renderer->stats;
+    ++stats.rendered;
+
+    gint64 frame_time = wg_renderer->last_frame_time;
+    if (frame_time <= 0)
+        return;
+
+    auto latency_ms = (g_get_monotonic_time() - frame_time) / 1000;
+    int bucket = 0;
+    while (bucket < VIDEO_WIDGET_LATENCY_BUCKETS - 1
+           && latency_ms > video_widget_latency_bucket_ms[bucket])
+        ++bucket;
+    ++stats.latency_histogram[bucket];
+}
+
+static void
+convert_snapshot(GTask *task,
+                 G_GNUC_UNUSED gpointer source_object,
+                 gpointer task_data,
+                 G_GNUC_UNUSED GCancellable *cancellable)
+{
+    auto job = (SnapshotJob *)task_data;
+
+    gsize pixel_count = (gsize)job->width * job->height;
+    auto pixbuf_frame_data = (guchar *)g_malloc(pixel_count * 3);
+    pixel_convert_bgra_to_rgb(job->bgra, pixbuf_frame_data, pixel_count);
+
+    auto snapshot = gdk_pixbuf_new_from_data(pixbuf_frame_data,
+                                             GDK_COLORSPACE_RGB, FALSE, 8,
+                                             job->width, job->height,
+                                             job->width * 3, free_pixels, NULL);
+    g_task_return_pointer(task, snapshot, g_object_unref);
+}
+
+static void
+on_snapshot_converted(VideoWidget *self, GAsyncResult *result, G_GNUC_UNUSED gpointer user_data)
+{
+    VideoWidgetPrivate *priv = VIDEO_WIDGET_GET_PRIVATE(self);
+
+    /* the buffer can be reused for the next snapshot */
+    priv->snapshot_pending = false;
+
+    auto snapshot = (GdkPixbuf *)g_task_propagate_pointer(G_TASK(result), nullptr);
+    if (!snapshot)
+        return;
+
+    if (priv->remote->snapshot)
+        g_object_unref(priv->remote->snapshot);
+    priv->remote->snapshot = snapshot;
+
+    g_signal_emit(G_OBJECT(self), video_widget_signals[SNAPSHOT_SIGNAL], 0);
+}
+
+/*
+ * get_black_frame()
+ *
+ * Returns a black image of the given size, or NULL if it could not be created.
+ * The images are shared by all the renderers and kept around, so that stopping
+ * and restarting the video doesn't allocate a new frame each time; only the
+ * most recently used sizes are kept.
+ */
+static ClutterContent *
+get_black_frame(guint width, guint height)
+{
+    struct BlackFrame {
+        guint           width;
+        guint           height;
+        ClutterContent *image;
+    };
+    /* sizes are usually the same few camera resolutions */
+    static constexpr size_t BLACK_FRAME_CACHE_SIZE = 4;
+    static std::vector<BlackFrame> cache;
+
+    auto it = std::find_if(cache.begin(), cache.end(), [=](const BlackFrame& frame) {
+        return frame.width == width && frame.height == height;
+    });
+    if (it != cache.end()) {
+        /* move to the front, so the least recently used one is evicted first */
+        std::rotate(cache.begin(), it, it + 1);
+        return cache.front().image;
+    }
+
+    auto empty_data = (guint8 *)g_try_malloc0((gsize)width * height * 4);
+    if (!empty_data)
+        return nullptr;
+
+    auto image = clutter_image_new();
+    GError* error = NULL;
+    clutter_image_set_data(
+            CLUTTER_IMAGE(image),
+            empty_data,
+            COGL_PIXEL_FORMAT_BGRA_8888,
+            width,
+            height,
+            width*4,
+            &error);
+    g_free(empty_data);
+    if (error) {
+        g_warning("error rendering empty image to clutter: %s", error->message);
+        g_clear_error(&error);
+        g_object_unref(image);
+        return nullptr;
+    }
+
+    if (cache.size() == BLACK_FRAME_CACHE_SIZE) {
+        g_object_unref(cache.back().image);
+        cache.pop_back();
+    }
+    cache.insert(cache.begin(), {width, height, image});
+    return image;
+}
+
+/*
+ * upload_frame()
+ *
+ * Uploads BGRA pixels into the persistent image of the renderer, only
+ * reallocating its texture when the size changed. new_image is set to true if
+ * the image must be (re)set as the content of the actor.
+ */
+static gboolean
+upload_frame(VideoWidgetRenderer *wg_renderer,
+             const guint8 *data,
+             gint width,
+             gint height,
+             gint row_stride,
+             bool *new_image)
+{
+    GError *error = nullptr;
+    if (wg_renderer->image
+        && wg_renderer->image_width == width
+        && wg_renderer->image_height == height) {
+        /* same size as the previous frame: update the existing texture */
+        cairo_rectangle_int_t rect = { 0, 0, width, height };
+        clutter_image_set_area(
+            CLUTTER_IMAGE(wg_renderer->image),
+            data,
+            COGL_PIXEL_FORMAT_BGRA_8888,
+            &rect,
+            row_stride,
+            &error);
+    } else {
+        /* first frame or the resolution changed: (re)allocate the texture */
+        if (!wg_renderer->image)
+            wg_renderer->image = clutter_image_new();
+        g_return_val_if_fail(wg_renderer->image, FALSE);
+
+        clutter_image_set_data(
+            CLUTTER_IMAGE(wg_renderer->image),
+            data,
+            COGL_PIXEL_FORMAT_BGRA_8888,
+            width,
+            height,
+            row_stride,
+            &error);
+        wg_renderer->image_width = width;
+        wg_renderer->image_height = height;
+        *new_image = true;
+    }
+    if (error) {
+        g_warning("error rendering image to clutter: %s", error->message);
+        g_clear_error(&error);
+        g_clear_object(&wg_renderer->image);
+        wg_renderer->image_width = wg_renderer->image_height = 0;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * show_frame()
+ *
+ * To be called once a new frame was uploaded to the image of the renderer.
+ */
+static void
+show_frame(VideoWidgetRenderer *wg_renderer, bool new_image)
+{
+    auto actor = wg_renderer->actor;
+
+    record_rendered_frame(wg_renderer);
+
+    /* the actor may be showing a black frame (or the image of a previous
+     * renderer), in which case our image must be set back as its content */
+    if (!new_image && clutter_actor_get_content(actor) == wg_renderer->image)
+        return;
+
+    clutter_actor_set_content(actor, wg_renderer->image);
+
+    /* note: we must set the content gravity be "resize aspect" after setting the image data to make sure
+     * that the aspect ratio is correct
+     */
+    clutter_actor_set_content_gravity(actor, CLUTTER_CONTENT_GRAVITY_RESIZE_ASPECT);
+}
+
+/* parameters of a downscale, copied when it is queued so that the worker
+ * doesn't read what the main thread may be changing */
+typedef struct {
+    VideoWidgetRenderer *wg_renderer;
+    gint                 target_width;
+    gint                 target_height;
+    /* black_generation of the renderer when the job was queued */
+    guint                black_generation;
+} DownscaleJob;
+
+static void
+downscale_frame(GTask *task,
+                G_GNUC_UNUSED gpointer source_object,
+                gpointer task_data,
+                G_GNUC_UNUSED GCancellable *cancellable)
+{
+    auto job = (DownscaleJob *)task_data;
+    auto wg_renderer = job->wg_renderer;
+
+    /* the renderer's frame is only read while holding the lock, as on the main
+     * thread; the main thread doesn't take it for downscaled renderers */
+    std::lock_guard<std::mutex> lock(wg_renderer->run_mutex);
+
+    auto renderer = wg_renderer->renderer;
+    if (!wg_renderer->running || !renderer) {
+        g_task_return_boolean(task, FALSE);
+        return;
+    }
+
+    /* read before the frame: a frame announced after this is newer than the
+     * one downscaled, so it will be displayed by the next pass */
+    wg_renderer->scaled_seq = wg_renderer->frame_seq;
+    auto frame_ptr = renderer->currentFrame();
+    auto frame_data = frame_ptr.ptr;
+    const auto& res = renderer->size();
+    if (!frame_data || res.width() <= 0 || res.height() <= 0) {
+        g_task_return_boolean(task, FALSE);
+        return;
+    }
+
+    /* fit the frame in the target area, keeping its aspect ratio; frames
+     * which are already small enough are kept at their size */
+    auto scale = std::min({(gdouble)job->target_width / res.width(),
+                           (gdouble)job->target_height / res.height(),
+                           1.0});
+    gint width = std::max(1, (gint)(res.width() * scale + 0.5));
+    gint height = std::max(1, (gint)(res.height() * scale + 0.5));
+
+    gsize size = (gsize)width * height * 4;
+    if (wg_renderer->scaled_buffer_size < size) {
+        wg_renderer->scaled_buffer = (guint8 *)g_realloc(wg_renderer->scaled_buffer, size);
+        wg_renderer->scaled_buffer_size = size;
+    }
+    pixel_convert_downscale_bgra(frame_data, res.width(), res.height(), res.width() * 4,
+                                 wg_renderer->scaled_buffer, width, height);
+    wg_renderer->scaled_width = width;
+    wg_renderer->scaled_height = height;
+
+    g_task_return_boolean(task, TRUE);
+}
+
+static void
+on_frame_downscaled(G_GNUC_UNUSED VideoWidget *self, GAsyncResult *result, VideoWidgetRenderer *wg_renderer)
 {
+    wg_renderer->downscale_pending = false;
+
+    if (wg_renderer->free_pending) {
+        /* the renderer was replaced while the frame was being downscaled */
+        free_video_widget_renderer(wg_renderer);
+        return;
+    }
+
+    auto job = (DownscaleJob *)g_task_get_task_data(G_TASK(result));
+    if (!g_task_propagate_boolean(G_TASK(result), nullptr)
+        || job->black_generation != wg_renderer->black_generation) {
+        if (wg_renderer->frame_seq != wg_renderer->rendered_seq)
+            g_main_context_wakeup(NULL);
+        return;
+    }
+
+    /* the worker may have read a frame which arrived after the downscale was
+     * started, the ones in between were never shown */
+    if (wg_renderer->scaled_seq > wg_renderer->rendered_seq) {
+        wg_renderer->stats.dropped += wg_renderer->scaled_seq - wg_renderer->rendered_seq;
+        wg_renderer->rendered_seq = wg_renderer->scaled_seq;
+    }
+    /* let the frame source display the frames which arrived since */
+    if (wg_renderer->frame_seq != wg_renderer->rendered_seq)
+        g_main_context_wakeup(NULL);
+
+    /* a black frame may have been requested in the meantime, the ones
+     * already shown are handled by black_generation */
+    if (wg_renderer->show_black_frame || wg_renderer->pause_rendering)
+        return;
+
+    auto start_time = g_get_monotonic_time();
+    bool new_image = false;
+    if (upload_frame(wg_renderer,
+                     wg_renderer->scaled_buffer,
+                     wg_renderer->scaled_width,
+                     wg_renderer->scaled_height,
+                     wg_renderer->scaled_width * 4,
+                     &new_image))
+        show_frame(wg_renderer, new_image);
+    record_render_time(wg_renderer, start_time);
+}
+
+static void
+start_downscale(VideoWidget *self, VideoWidgetRenderer *wg_renderer)
+{
+    wg_renderer->downscale_pending = true;
+
+    auto job = g_new(DownscaleJob, 1);
+    job->wg_renderer = wg_renderer;
+    job->target_width = wg_renderer->target_width;
+    job->target_height = wg_renderer->target_height;
+    job->black_generation = wg_renderer->black_generation;
+
+    /* the task keeps the widget alive until it's done */
+    auto task = g_task_new(self, nullptr, (GAsyncReadyCallback)on_frame_downscaled, wg_renderer);
+    g_task_set_task_data(task, job, g_free);
+    g_task_run_in_thread(task, downscale_frame);
+    g_object_unref(task);
+}
+
+static void
+clutter_render_image(VideoWidget *self, VideoWidgetRenderer* wg_renderer)
+{
+    VideoWidgetPrivate *priv = VIDEO_WIDGET_GET_PRIVATE(self);
     auto actor = wg_renderer->actor;
     g_return_if_fail(CLUTTER_IS_ACTOR(actor));
 
     if (wg_renderer->pause_rendering)
         return;
 
+    /* the frame will be handled once the current downscale is done, see
+     * on_frame_downscaled() */
+    if (wg_renderer->downscale_pending && !wg_renderer->show_black_frame)
+        return;
+
+    /* don't re-upload a frame which is already displayed */
+    const guint64 frame_seq = wg_renderer->frame_seq;
+    if (frame_seq == wg_renderer->rendered_seq && !wg_renderer->show_black_frame) {
+        ++wg_renderer->stats.duplicates;
+        return;
+    }
+    /* frames which arrived since the last upload were never shown */
+    if (frame_seq > wg_renderer->rendered_seq + 1)
+        wg_renderer->stats.dropped += frame_seq - wg_renderer->rendered_seq - 1;
+    wg_renderer->rendered_seq = frame_seq;
+
     if (wg_renderer->show_black_frame) {
         /* render a black frame set the bool back to false, this is likely done
          * when the renderer is stopped so we ignore whether or not it is running
@@ -651,46 +1115,37 @@ clutter_render_image(VideoWidgetRenderer* wg_renderer)
             gfloat height;
             if (clutter_content_get_preferred_size(image_old, &width, &height)) {
                 /* NOTE: this is a workaround for #72531, a crash which occurs
-                 * in cogl < 1.18. We allocate a black frame of the same size
+                 * in cogl < 1.18. We use a black frame of the same size
                  * as the previous image, instead of simply setting an empty or
                  * a NULL ClutterImage.
                  */
-                auto image_empty = clutter_image_new();
-                if (auto empty_data = (guint8 *)g_try_malloc0((gsize)width * height * 4)) {
-                    GError* error = NULL;
-                    clutter_image_set_data(
-                            CLUTTER_IMAGE(image_empty),
-                            empty_data,
-                            COGL_PIXEL_FORMAT_BGRA_8888,
-                            (guint)width,
-                            (guint)height,
-                            (guint)width*4,
-                            &error);
-                    if (error) {
-                        g_warning("error rendering empty image to clutter: %s", error->message);
-                        g_clear_error(&error);
-                        g_object_unref(image_empty);
-                        return;
-                    }
-                    clutter_actor_set_content(actor, image_empty);
-                    g_object_unref(image_empty);
-                    g_free(empty_data);
-                } else {
-                    clutter_actor_set_content(actor, NULL);
-                }
+                clutter_actor_set_content(actor, get_black_frame((guint)width, (guint)height));
             } else {
                 clutter_actor_set_content(actor, NULL);
             }
         }
         wg_renderer->show_black_frame = false;
+        /* drop the frame of a downscale started before the renderer stopped */
+        ++wg_renderer->black_generation;
         return;
     }
 
-    ClutterContent *image_new = nullptr;
+    if (wg_renderer->target_width > 0 && wg_renderer->target_height > 0) {
+        /* the frame is only fetched by the worker, so it always downscales
+         * the latest one */
+        start_downscale(self, wg_renderer);
+        return;
+    }
+
+    bool set_content = false;
+    SnapshotJob *snapshot_job = nullptr;
+    auto start_time = g_get_monotonic_time();
 
     {
         /* the following must be done under lock in case a 'stopped' signal is
-         * received during rendering; otherwise the mem could become invalid */
+         * received during rendering; otherwise the mem could become invalid;
+         * the frame is uploaded straight from the renderer's buffer into the
+         * texture, so nothing else is done while holding the lock */
         std::lock_guard<std::mutex> lock(wg_renderer->run_mutex);
 
         if (!wg_renderer->running)
@@ -705,64 +1160,42 @@ clutter_render_image(VideoWidgetRenderer* wg_renderer)
         if (!frame_data)
             return;
 
-        image_new = clutter_image_new();
-        g_return_if_fail(image_new);
-
         const auto& res = renderer->size();
         gint BPP = 4; /* BGRA */
         gint ROW_STRIDE = BPP * res.width();
 
-        GError *error = nullptr;
-        clutter_image_set_data(
-            CLUTTER_IMAGE(image_new),
-            frame_data,
-            COGL_PIXEL_FORMAT_BGRA_8888,
-            res.width(),
-            res.height(),
-            ROW_STRIDE,
-            &error);
-        if (error) {
-            g_warning("error rendering image to clutter: %s", error->message);
-            g_clear_error(&error);
-            g_object_unref (image_new);
+        if (!upload_frame(wg_renderer, frame_data, res.width(), res.height(), ROW_STRIDE, &set_content))
             return;
-        }
 
-        if (wg_renderer->snapshot_status == HAS_TO_TAKE_ONE) {
-            guchar *pixbuf_frame_data = (guchar *)g_malloc(res.width() * res.height() * 3);
-
-            BPP = 3; /* RGB */
-            gint ROW_STRIDE = BPP * res.width();
-
-            /* conversion from BGRA to RGB */
-            for(int i = 0, j = 0 ; i < res.width() * res.height() * 4 ; i += 4, j += 3 ) {
-                pixbuf_frame_data[j + 0] = frame_data[i + 2];
-                pixbuf_frame_data[j + 1] = frame_data[i + 1];
-                pixbuf_frame_data[j + 2] = frame_data[i + 0];
-            }
-
-            if (wg_renderer->snapshot) {
-                g_object_unref(wg_renderer->snapshot);
-                wg_renderer->snapshot = nullptr;
+        if (wg_renderer->snapshot_status == HAS_TO_TAKE_ONE && !priv->snapshot_pending) {
+            /* only copy the frame here, the conversion is done off the main
+             * thread once the lock is released */
+            gsize size = (gsize)res.width() * res.height() * 4;
+            if (priv->snapshot_buffer_size != size) {
+                priv->snapshot_buffer = (guint8 *)g_realloc(priv->snapshot_buffer, size);
+                priv->snapshot_buffer_size = size;
             }
+            memcpy(priv->snapshot_buffer, frame_data, size);
 
-            wg_renderer->snapshot = gdk_pixbuf_new_from_data(pixbuf_frame_data,
-                                                             GDK_COLORSPACE_RGB, FALSE, 8,
-                                                             res.width(), res.height(),
-                                                             ROW_STRIDE, free_pixels, NULL);
-
-            wg_renderer->snapshot_status = HAS_A_NEW_ONE;
+            snapshot_job = g_new(SnapshotJob, 1);
+            snapshot_job->bgra = priv->snapshot_buffer;
+            snapshot_job->width = res.width();
+            snapshot_job->height = res.height();
 
+            priv->snapshot_pending = true;
+            wg_renderer->snapshot_status = NOTHING;
         }
     }
 
-    clutter_actor_set_content(actor, image_new);
-    g_object_unref (image_new);
+    if (snapshot_job) {
+        auto task = g_task_new(self, nullptr, (GAsyncReadyCallback)on_snapshot_converted, nullptr);
+        g_task_set_task_data(task, snapshot_job, g_free);
+        g_task_run_in_thread(task, convert_snapshot);
+        g_object_unref(task);
+    }
 
-    /* note: we must set the content gravity be "resize aspect" after setting the image data to make sure
-     * that the aspect ratio is correct
-     */
-    clutter_actor_set_content_gravity(actor, CLUTTER_CONTENT_GRAVITY_RESIZE_ASPECT);
+    show_frame(wg_renderer, set_content);
+    record_render_time(wg_renderer, start_time);
 }
 
 static gboolean
@@ -771,13 +1204,12 @@ check_frame_queue(VideoWidget *self)
     g_return_val_if_fail(IS_VIDEO_WIDGET(self), FALSE);
     VideoWidgetPrivate *priv = VIDEO_WIDGET_GET_PRIVATE(self);
 
+    /* swap in the new renderers first, so their frames are displayed */
+    check_renderer_queue(self);
+
     /* display renderer's frames */
-    clutter_render_image(priv->local);
-    clutter_render_image(priv->remote);
-    if (priv->remote->snapshot_status == HAS_A_NEW_ONE) {
-        priv->remote->snapshot_status = NOTHING;
-        g_signal_emit(G_OBJECT(self), video_widget_signals[SNAPSHOT_SIGNAL], 0);
-    }
+    clutter_render_image(self, priv->local);
+    clutter_render_image(self, priv->remote);
 
     return TRUE; /* keep going */
 }
@@ -793,6 +1225,7 @@ renderer_stop(VideoWidgetRenderer *renderer)
     }
     /* ask to show a black frame */
     renderer->show_black_frame = true;
+    g_main_context_wakeup(NULL);
 }
 
 static void
@@ -803,6 +1236,20 @@ renderer_start(VideoWidgetRenderer *renderer)
         renderer->running = true;
     }
     renderer->show_black_frame = false;
+    /* make sure the current frame gets displayed even if no new one arrives */
+    renderer->frame_seq++;
+    g_main_context_wakeup(NULL);
+}
+
+static void
+renderer_frame_updated(VideoWidgetRenderer *renderer)
+{
+    /* LRC frames carry no capture timestamp, so latency is measured from the
+     * moment the frame is announced */
+    renderer->last_frame_time = g_get_monotonic_time();
+    renderer->frames_received++;
+    renderer->frame_seq++;
+    g_main_context_wakeup(NULL);
 }
 
 static void
@@ -810,8 +1257,16 @@ free_video_widget_renderer(VideoWidgetRenderer *renderer)
 {
     QObject::disconnect(renderer->render_stop);
     QObject::disconnect(renderer->render_start);
+    QObject::disconnect(renderer->render_update);
+    if (renderer->downscale_pending) {
+        /* the worker is still using it, on_frame_downscaled() will free it */
+        renderer->free_pending = true;
+        return;
+    }
+    g_free(renderer->scaled_buffer);
     if (renderer->snapshot)
         g_object_unref(renderer->snapshot);
+    g_clear_object(&renderer->image);
     g_free(renderer);
 }
 
@@ -840,6 +1295,8 @@ video_widget_add_renderer(VideoWidget *self, VideoWidgetRenderer *new_video_rend
             /* swap the remote renderer */
             new_video_renderer->actor = priv->local->actor;
             new_video_renderer->drag_action = priv->local->drag_action;
+            new_video_renderer->target_width = priv->local->target_width;
+            new_video_renderer->target_height = priv->local->target_height;
             free_video_widget_renderer(priv->local);
             priv->local = new_video_renderer;
             /* reset the content gravity so that the aspect ratio gets properly
@@ -852,10 +1309,10 @@ video_widget_add_renderer(VideoWidget *self, VideoWidgetRenderer *new_video_rend
     }
 }
 
-static gboolean
+static void
 check_renderer_queue(VideoWidget *self)
 {
-    g_return_val_if_fail(IS_VIDEO_WIDGET(self), G_SOURCE_REMOVE);
+    g_return_if_fail(IS_VIDEO_WIDGET(self));
     VideoWidgetPrivate *priv = VIDEO_WIDGET_GET_PRIVATE(self);
 
     /* get all the renderers in the queue */
@@ -864,8 +1321,6 @@ check_renderer_queue(VideoWidget *self)
         video_widget_add_renderer(self, new_video_renderer);
         new_video_renderer = (VideoWidgetRenderer *)g_async_queue_try_pop(priv->new_renderer_queue);
     }
-
-    return G_SOURCE_CONTINUE;
 }
 
 /*
@@ -895,6 +1350,9 @@ video_widget_push_new_renderer(VideoWidget *self, Video::Renderer *renderer, Vid
     /* if the renderer is nullptr, there is nothing to be done */
     if (!renderer) return;
 
+    /* the widget is being destroyed */
+    if (!priv->new_renderer_queue) return;
+
     VideoWidgetRenderer *new_video_renderer = g_new0(VideoWidgetRenderer, 1);
     new_video_renderer->renderer = renderer;
     new_video_renderer->type = type;
@@ -918,7 +1376,17 @@ video_widget_push_new_renderer(VideoWidget *self, Video::Renderer *renderer, Vid
         }
     );
 
+    new_video_renderer->render_update = QObject::connect(
+        new_video_renderer->renderer,
+        &Video::Renderer::frameUpdated,
+        [=]() {
+            renderer_frame_updated(new_video_renderer);
+        }
+    );
+
     g_async_queue_push(priv->new_renderer_queue, new_video_renderer);
+    /* the frame source will pick it up on the next main loop iteration */
+    g_main_context_wakeup(NULL);
 }
 
 void
@@ -946,3 +1414,65 @@ video_widget_get_snapshot(VideoWidget *self)
 
     return priv->remote->snapshot;
 }
+
+/**
+ * video_widget_get_stats()
+ *
+ * Fills stats with the frame counters of the current renderer of the given
+ * type. The counters are reset whenever a new renderer is pushed.
+ * Returns FALSE if there is no such renderer.
+ */
+gboolean
+video_widget_get_stats(VideoWidget *self, VideoRendererType type, VideoWidgetStats *stats)
+{
+    g_return_val_if_fail(IS_VIDEO_WIDGET(self), FALSE);
+    g_return_val_if_fail(stats, FALSE);
+    VideoWidgetPrivate *priv = VIDEO_WIDGET_GET_PRIVATE(self);
+
+    VideoWidgetRenderer *renderer = nullptr;
+    switch(type) {
+        case VIDEO_RENDERER_REMOTE:
+            renderer = priv->remote;
+            break;
+        case VIDEO_RENDERER_LOCAL:
+            renderer = priv->local;
+            break;
+        case VIDEO_RENDERER_COUNT:
+            break;
+    }
+    if (!renderer)
+        return FALSE;
+
+    *stats = renderer->stats;
+    stats->received = renderer->frames_received;
+    return TRUE;
+}
+
+/**
+ * video_widget_stats_get_latency_percentile()
+ *
+ * Returns the upper bound, in ms, of the latency histogram bucket containing
+ * the given percentile (0 - 100) of the rendered frames, 0 if no frame was
+ * rendered yet, or VIDEO_WIDGET_LATENCY_UNBOUNDED if it is above
+ * VIDEO_WIDGET_LATENCY_MAX_MS.
+ */
+guint
+video_widget_stats_get_latency_percentile(const VideoWidgetStats *stats, gdouble percentile)
+{
+    g_return_val_if_fail(stats, 0);
+
+    guint64 total = 0;
+    for (int i = 0; i < VIDEO_WIDGET_LATENCY_BUCKETS; ++i)
+        total += stats->latency_histogram[i];
+    if (total == 0)
+        return 0;
+
+    auto threshold = (guint64)(total * CLAMP(percentile, 0.0, 100.0) / 100.0);
+    guint64 count = 0;
+    for (int i = 0; i < VIDEO_WIDGET_LATENCY_BUCKETS; ++i) {
+        count += stats->latency_histogram[i];
+        if (count >= threshold && count > 0)
+            return video_widget_latency_bucket_ms[i];
+    }
+    return video_widget_latency_bucket_ms[VIDEO_WIDGET_LATENCY_BUCKETS - 1];
+}
@@ -42,6 +42,24 @@ typedef enum {
     VIDEO_RENDERER_COUNT
 } VideoRendererType;
 
+/* number of frame latency histogram buckets, bounded by 5, 10, 17, 33, 50 and
+ * VIDEO_WIDGET_LATENCY_MAX_MS; the last bucket holds everything above */
+#define VIDEO_WIDGET_LATENCY_BUCKETS 7
+#define VIDEO_WIDGET_LATENCY_MAX_MS 100
+/* returned by video_widget_stats_get_latency_percentile() for the last bucket */
+#define VIDEO_WIDGET_LATENCY_UNBOUNDED G_MAXUINT
+
+typedef struct {
+    guint64 received;   /* frames announced by the renderer */
+    guint64 rendered;   /* frames uploaded to the actor */
+    guint64 duplicates; /* render passes skipped because no new frame was available */
+    guint64 dropped;    /* frames replaced by a newer one before they could be displayed */
+    guint64 render_time_us;     /* main thread time spent fetching and uploading frames */
+    guint64 max_render_time_us; /* longest time a single upload blocked the main loop */
+    /* time between a frame being announced and it being uploaded */
+    guint64 latency_histogram[VIDEO_WIDGET_LATENCY_BUCKETS];
+} VideoWidgetStats;
+
 /* Public interface */
 GType           video_widget_get_type          (void) G_GNUC_CONST;
 GtkWidget*      video_widget_new               (void);
@@ -60,6 +78,11 @@ gboolean        video_widget_on_button_press_in_screen_event (VideoWidget *self,
                                                               Call* call);
 void            video_widget_take_snapshot (VideoWidget *self);
 GdkPixbuf*      video_widget_get_snapshot  (VideoWidget *self);
+gboolean        video_widget_get_stats     (VideoWidget *self,
+                                            VideoRendererType type,
+                                            VideoWidgetStats *stats);
+guint           video_widget_stats_get_latency_percentile (const VideoWidgetStats *stats,
+                                                           gdouble percentile);
 
 G_END_DECLS
 
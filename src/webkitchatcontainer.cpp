@@ -23,19 +23,239 @@
 
 // GTK+ related
 #include <webkit2/webkit2.h>
-
-// Qt
-#include <QtCore/QJsonArray>
-#include <QtCore/QJsonValue>
-#include <QtCore/QJsonObject>
-#include <QtCore/QJsonDocument>
+#include <glib/gstdio.h>
 
 // LRC
 #include <globalinstances.h>
 #include <api/conversationmodel.h>
 
+// std
+#include <algorithm>
+#include <functional>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
 // Ring Client
 #include "native/pixbufmanipulator.h"
+#include "utils/jsonwriter.h"
+
+namespace details
+{
+
+/**
+ * Changes of interactions which have not been sent to the web view yet. They
+ * are coalesced per interaction: an update replaces a pending add or update of
+ * the same interaction, and removing an interaction which was never sent
+ * drops it altogether.
+ */
+class PendingDelta
+{
+public:
+    /* interaction is the JSON object of the interaction */
+    void add(uint64_t id, const std::string& interaction);
+    void update(uint64_t id, const std::string& interaction);
+    void remove(uint64_t id);
+
+    bool empty() const { return entries_.empty(); }
+    void clear();
+
+    /* writes the changes as a JSON array for applyInteractionDelta() and
+     * clears them */
+    void takeJson(JsonWriter& writer);
+
+private:
+    enum class Operation { ADD, UPDATE, REMOVE, NONE };
+
+    struct Entry
+    {
+        Operation operation;
+        uint64_t id;
+        std::string interaction;
+    };
+
+    std::vector<Entry> entries_;
+    std::map<uint64_t, std::size_t> index_; ///< last entry of each interaction
+};
+
+void
+PendingDelta::add(uint64_t id, const std::string& interaction)
+{
+    index_[id] = entries_.size();
+    entries_.push_back({Operation::ADD, id, interaction});
+}
+
+void
+PendingDelta::update(uint64_t id, const std::string& interaction)
+{
+    auto it = index_.find(id);
+    if (it != index_.end()) {
+        auto& entry = entries_[it->second];
+        if (entry.operation == Operation::ADD || entry.operation == Operation::UPDATE) {
+            entry.interaction = interaction;
+            return;
+        }
+    }
+    index_[id] = entries_.size();
+    entries_.push_back({Operation::UPDATE, id, interaction});
+}
+
+void
+PendingDelta::remove(uint64_t id)
+{
+    auto it = index_.find(id);
+    if (it != index_.end()) {
+        auto& entry = entries_[it->second];
+        switch (entry.operation) {
+        case Operation::ADD:
+            /* never displayed, nothing to remove */
+            entry.operation = Operation::NONE;
+            entry.interaction.clear();
+            index_.erase(it);
+            return;
+        case Operation::UPDATE:
+            entry.operation = Operation::REMOVE;
+            entry.interaction.clear();
+            return;
+        case Operation::REMOVE:
+            return;
+        case Operation::NONE:
+            break;
+        }
+    }
+    index_[id] = entries_.size();
+    entries_.push_back({Operation::REMOVE, id, std::string()});
+}
+
+void
+PendingDelta::clear()
+{
+    entries_.clear();
+    index_.clear();
+}
+
+void
+PendingDelta::takeJson(JsonWriter& writer)
+{
+    writer.beginArray();
+    for (const auto& entry : entries_) {
+        switch (entry.operation) {
+        case Operation::ADD:
+            writer.beginArray();
+            writer.literal("a");
+            writer.serialized(entry.interaction);
+            writer.endArray();
+            break;
+        case Operation::UPDATE:
+            writer.beginArray();
+            writer.literal("u");
+            writer.serialized(entry.interaction);
+            writer.endArray();
+            break;
+        case Operation::REMOVE:
+            writer.beginArray();
+            writer.literal("r");
+            writer.valueAsString(static_cast<guint64>(entry.id));
+            writer.endArray();
+            break;
+        case Operation::NONE:
+            break;
+        }
+    }
+    writer.endArray();
+    clear();
+}
+
+/**
+ * Decoded sender avatars served to the web view through the ring-avatar://
+ * URI scheme, so the web view references them by URL instead of receiving
+ * their base64 data again each time a conversation is displayed. The URL of an
+ * avatar contains the profile id of the sender and a hash of the avatar: it
+ * changes when the avatar changes, so WebKit can cache the image it decoded.
+ * The least recently used avatars are evicted.
+ */
+class AvatarCache
+{
+public:
+    ~AvatarCache();
+
+    /* stores the base64 encoded avatar of a profile if it is not cached
+     * already, and returns its URL */
+    std::string put(const std::string& profileId, const std::string& avatar);
+
+    /* returns a new reference to the avatar at uri, or nullptr */
+    GBytes* lookup(const std::string& uri);
+
+private:
+    static constexpr std::size_t CAPACITY = 64;
+
+    struct Entry
+    {
+        std::string uri;
+        GBytes* image;
+    };
+
+    std::list<Entry> entries_; ///< most recently used first
+    std::map<std::string, std::list<Entry>::iterator> index_; ///< by uri up to the hash
+};
+
+AvatarCache::~AvatarCache()
+{
+    for (auto& entry : entries_)
+        g_bytes_unref(entry.image);
+}
+
+std::string
+AvatarCache::put(const std::string& profileId, const std::string& avatar)
+{
+    gchar* escaped_id = g_uri_escape_string(profileId.c_str(), nullptr, FALSE);
+    std::string prefix = std::string("ring-avatar://") + escaped_id + "/";
+    g_free(escaped_id);
+
+    gchar* hash = g_strdup_printf("%zx", std::hash<std::string>()(avatar));
+    auto uri = prefix + hash;
+    g_free(hash);
+
+    auto it = index_.find(prefix);
+    if (it != index_.end()) {
+        if (it->second->uri == uri) {
+            entries_.splice(entries_.begin(), entries_, it->second);
+            return uri;
+        }
+        /* the avatar of this profile changed */
+        g_bytes_unref(it->second->image);
+        entries_.erase(it->second);
+        index_.erase(it);
+    }
+
+    gsize size = 0;
+    auto* data = g_base64_decode(avatar.c_str(), &size);
+    entries_.push_front({uri, g_bytes_new_take(data, size)});
+    index_[prefix] = entries_.begin();
+
+    if (entries_.size() > CAPACITY) {
+        auto& last = entries_.back();
+        index_.erase(last.uri.substr(0, last.uri.rfind('/') + 1));
+        g_bytes_unref(last.image);
+        entries_.pop_back();
+    }
+
+    return uri;
+}
+
+GBytes*
+AvatarCache::lookup(const std::string& uri)
+{
+    auto it = index_.find(uri.substr(0, uri.rfind('/') + 1));
+    if (it == index_.end() || it->second->uri != uri)
+        return nullptr;
+
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return g_bytes_ref(it->second->image);
+}
+
+} // namespace details
 
 struct _WebKitChatContainer
 {
@@ -57,9 +277,25 @@ struct _WebKitChatContainerPrivate
     bool       chatview_debug;
     gchar*     data_received;
 
-    /* Array of javascript libraries to load. Used during initialization */
-    GList*     js_libs_to_load;
-    gboolean   js_libs_loaded;
+    /* whether chatview.html and its libraries are loaded */
+    gboolean   page_loaded;
+
+    /* web view whose web process crashed, displayed until its replacement
+     * is loaded */
+    GtkWidget* crashed_webview_chat;
+
+    /* state of the page restored when the web view is rebuilt */
+    bool       header_hidden;
+
+    /* interaction changes are sent to the web view in batches, by an idle
+     * source, instead of one javascript call per change */
+    details::PendingDelta* pending_delta;
+    guint      flush_delta_source;
+
+    /* reusable buffers for the javascript calls carrying interactions, one
+     * for the pending changes as they are flushed before any other call */
+    JsonWriter* json_writer;
+    JsonWriter* delta_writer;
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE(WebKitChatContainer, webkit_chat_container, GTK_TYPE_BOX);
@@ -82,19 +318,275 @@ static gboolean webview_crashed(WebKitChatContainer *self);
 static void
 webkit_chat_container_dispose(GObject *object)
 {
+    WebKitChatContainerPrivate *priv = WEBKIT_CHAT_CONTAINER_GET_PRIVATE(object);
+
+    if (priv->flush_delta_source) {
+        g_source_remove(priv->flush_delta_source);
+        priv->flush_delta_source = 0;
+    }
+
     G_OBJECT_CLASS(webkit_chat_container_parent_class)->dispose(object);
 }
 
+static void
+webkit_chat_container_finalize(GObject *object)
+{
+    WebKitChatContainerPrivate *priv = WEBKIT_CHAT_CONTAINER_GET_PRIVATE(object);
+
+    delete priv->pending_delta;
+    priv->pending_delta = nullptr;
+    delete priv->json_writer;
+    priv->json_writer = nullptr;
+    delete priv->delta_writer;
+    priv->delta_writer = nullptr;
+
+    G_OBJECT_CLASS(webkit_chat_container_parent_class)->finalize(object);
+}
+
 static void
 webkit_chat_container_init(WebKitChatContainer *view)
 {
     gtk_widget_init_template(GTK_WIDGET(view));
+
+    WebKitChatContainerPrivate *priv = WEBKIT_CHAT_CONTAINER_GET_PRIVATE(view);
+    priv->pending_delta = new details::PendingDelta();
+    priv->json_writer = new JsonWriter();
+    priv->delta_writer = new JsonWriter();
+}
+
+static details::AvatarCache&
+avatar_cache()
+{
+    static details::AvatarCache cache;
+    return cache;
+}
+
+static void
+avatar_uri_scheme_request(WebKitURISchemeRequest *request, G_GNUC_UNUSED gpointer user_data)
+{
+    auto uri = webkit_uri_scheme_request_get_uri(request);
+    if (auto* image = avatar_cache().lookup(uri)) {
+        auto* stream = g_memory_input_stream_new_from_bytes(image);
+        /* let WebKit sniff the image type */
+        webkit_uri_scheme_request_finish(request, stream, g_bytes_get_size(image), nullptr);
+        g_object_unref(stream);
+        g_bytes_unref(image);
+    } else {
+        GError *error = g_error_new(G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "no avatar for %s", uri);
+        webkit_uri_scheme_request_finish_error(request, error);
+        g_error_free(error);
+    }
+}
+
+/* largest size of the previews of transferred images, matches the largest
+ * size of ".media_wrapper img" in chatview.css */
+static constexpr int THUMBNAIL_SIZE = 800;
+
+/* the least recently used thumbnails are removed beyond this size */
+static constexpr gint64 THUMBNAIL_CACHE_MAX_SIZE = 100 * 1024 * 1024;
+
+static gchar*
+thumbnail_cache_dir()
+{
+    return g_build_filename(g_get_user_cache_dir(), "ring", "thumbnails", NULL);
+}
+
+/**
+ * Path of the cached thumbnail of a file. The modification time and size of
+ * the file are part of the key so a modified file gets a new thumbnail.
+ */
+static gchar*
+thumbnail_cache_path(const gchar* path, const GStatBuf& file_stat)
+{
+    gchar* key = g_strdup_printf("%s:%" G_GINT64_FORMAT ":%" G_GINT64_FORMAT,
+                                 path, (gint64)file_stat.st_mtime, (gint64)file_stat.st_size);
+    gchar* digest = g_compute_checksum_for_string(G_CHECKSUM_SHA1, key, -1);
+    gchar* cache_dir = thumbnail_cache_dir();
+    gchar* cache_path = g_build_filename(cache_dir, digest, NULL);
+    g_free(cache_dir);
+    g_free(digest);
+    g_free(key);
+    return cache_path;
+}
+
+/**
+ * Worker thread removing the least recently used thumbnails until the cache
+ * fits in THUMBNAIL_CACHE_MAX_SIZE. The modification time of a thumbnail is
+ * updated each time it is served, see load_thumbnail().
+ */
+static void
+prune_thumbnail_cache(GTask *task,
+                      G_GNUC_UNUSED gpointer source_object,
+                      G_GNUC_UNUSED gpointer task_data,
+                      G_GNUC_UNUSED GCancellable *cancellable)
+{
+    gchar* cache_dir = thumbnail_cache_dir();
+    GDir* dir = g_dir_open(cache_dir, 0, nullptr);
+    if (!dir) {
+        g_free(cache_dir);
+        g_task_return_boolean(task, TRUE);
+        return;
+    }
+
+    struct Thumbnail {
+        std::string path;
+        gint64 mtime;
+        gint64 size;
+    };
+    std::vector<Thumbnail> thumbnails;
+    gint64 total_size = 0;
+    while (auto* name = g_dir_read_name(dir)) {
+        gchar* path = g_build_filename(cache_dir, name, NULL);
+        GStatBuf file_stat;
+        if (g_stat(path, &file_stat) == 0 && S_ISREG(file_stat.st_mode)) {
+            thumbnails.push_back({path, (gint64)file_stat.st_mtime, (gint64)file_stat.st_size});
+            total_size += file_stat.st_size;
+        }
+        g_free(path);
+    }
+    g_dir_close(dir);
+    g_free(cache_dir);
+
+    if (total_size > THUMBNAIL_CACHE_MAX_SIZE) {
+        std::sort(thumbnails.begin(), thumbnails.end(),
+                  [] (const Thumbnail& a, const Thumbnail& b) { return a.mtime < b.mtime; });
+        for (const auto& thumbnail : thumbnails) {
+            if (total_size <= THUMBNAIL_CACHE_MAX_SIZE)
+                break;
+            if (g_remove(thumbnail.path.c_str()) == 0)
+                total_size -= thumbnail.size;
+        }
+    }
+
+    g_task_return_boolean(task, TRUE);
+}
+
+/**
+ * Worker thread of the ring-thumb:// scheme: returns the thumbnail of the file
+ * in task_data as GBytes. Images which already fit in THUMBNAIL_SIZE and
+ * animated GIFs are returned as they are.
+ */
+static void
+load_thumbnail(GTask *task,
+               G_GNUC_UNUSED gpointer source_object,
+               gpointer task_data,
+               G_GNUC_UNUSED GCancellable *cancellable)
+{
+    auto* path = static_cast<const gchar*>(task_data);
+    gchar* contents = nullptr;
+    gsize length = 0;
+    GError *error = nullptr;
+
+    GStatBuf file_stat;
+    if (g_stat(path, &file_stat) != 0) {
+        g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "%s not found", path);
+        return;
+    }
+
+    gchar* cache_path = thumbnail_cache_path(path, file_stat);
+    if (g_file_get_contents(cache_path, &contents, &length, nullptr)) {
+        /* mark it as recently used for prune_thumbnail_cache() */
+        g_utime(cache_path, nullptr);
+        g_free(cache_path);
+        g_task_return_pointer(task, g_bytes_new_take(contents, length), (GDestroyNotify)g_bytes_unref);
+        return;
+    }
+
+    gint width = 0, height = 0;
+    auto* format = gdk_pixbuf_get_file_info(path, &width, &height);
+    auto* format_name = format ? gdk_pixbuf_format_get_name(format) : nullptr;
+    auto keep_original = format && ((width <= THUMBNAIL_SIZE && height <= THUMBNAIL_SIZE)
+                                    || g_strcmp0(format_name, "gif") == 0);
+    g_free(format_name);
+
+    if (!format || keep_original) {
+        /* let WebKit report the error if the file is not an image */
+        if (g_file_get_contents(path, &contents, &length, &error))
+            g_task_return_pointer(task, g_bytes_new_take(contents, length), (GDestroyNotify)g_bytes_unref);
+        else
+            g_task_return_error(task, error);
+        g_free(cache_path);
+        return;
+    }
+
+    /* JPEG and PNG loaders decode at a reduced size directly */
+    auto* pixbuf = gdk_pixbuf_new_from_file_at_size(path, THUMBNAIL_SIZE, THUMBNAIL_SIZE, &error);
+    /* the EXIF orientation is lost once re-encoded */
+    if (pixbuf) {
+        auto* oriented = gdk_pixbuf_apply_embedded_orientation(pixbuf);
+        g_object_unref(pixbuf);
+        pixbuf = oriented;
+    }
+    auto saved = pixbuf && (gdk_pixbuf_get_has_alpha(pixbuf)
+        ? gdk_pixbuf_save_to_buffer(pixbuf, &contents, &length, "png", &error, NULL)
+        : gdk_pixbuf_save_to_buffer(pixbuf, &contents, &length, "jpeg", &error, "quality", "90", NULL));
+    if (pixbuf)
+        g_object_unref(pixbuf);
+
+    if (!saved) {
+        g_free(cache_path);
+        g_task_return_error(task, error);
+        return;
+    }
+
+    gchar* cache_dir = g_path_get_dirname(cache_path);
+    g_mkdir_with_parents(cache_dir, 0700);
+    if (!g_file_set_contents(cache_path, contents, length, &error)) {
+        g_warning("could not cache thumbnail of %s: %s", path, error->message);
+        g_clear_error(&error);
+    }
+    g_free(cache_dir);
+    g_free(cache_path);
+
+    g_task_return_pointer(task, g_bytes_new_take(contents, length), (GDestroyNotify)g_bytes_unref);
+}
+
+static void
+on_thumbnail_loaded(G_GNUC_UNUSED GObject *source_object, GAsyncResult *result, gpointer user_data)
+{
+    auto* request = WEBKIT_URI_SCHEME_REQUEST(user_data);
+    GError *error = nullptr;
+
+    if (auto* image = static_cast<GBytes*>(g_task_propagate_pointer(G_TASK(result), &error))) {
+        auto* stream = g_memory_input_stream_new_from_bytes(image);
+        webkit_uri_scheme_request_finish(request, stream, g_bytes_get_size(image), nullptr);
+        g_object_unref(stream);
+        g_bytes_unref(image);
+    } else {
+        webkit_uri_scheme_request_finish_error(request, error);
+        g_error_free(error);
+    }
+
+    g_object_unref(request);
+}
+
+/**
+ * ring-thumb://<path> serves a preview of the local image at path, which is
+ * generated on a worker thread and cached on disk.
+ */
+static void
+thumbnail_uri_scheme_request(WebKitURISchemeRequest *request, G_GNUC_UNUSED gpointer user_data)
+{
+    gchar* path = g_uri_unescape_string(webkit_uri_scheme_request_get_path(request), nullptr);
+    if (!path) {
+        GError *error = g_error_new(G_IO_ERROR, G_IO_ERROR_INVALID_FILENAME, "invalid path in %s",
+                                    webkit_uri_scheme_request_get_uri(request));
+        webkit_uri_scheme_request_finish_error(request, error);
+        g_error_free(error);
+        return;
+    }
+
+    auto* task = g_task_new(nullptr, nullptr, on_thumbnail_loaded, g_object_ref(request));
+    g_task_set_task_data(task, path, g_free);
+    g_task_run_in_thread(task, load_thumbnail);
+    g_object_unref(task);
 }
 
 static void
 webkit_chat_container_class_init(WebKitChatContainerClass *klass)
 {
     G_OBJECT_CLASS(klass)->dispose = webkit_chat_container_dispose;
+    G_OBJECT_CLASS(klass)->finalize = webkit_chat_container_finalize;
 
     gtk_widget_class_set_template_from_resource(GTK_WIDGET_CLASS (klass),
                                                 "/cx/ring/RingGnome/webkitchatcontainer.ui");
@@ -128,6 +620,24 @@ webkit_chat_container_class_init(WebKitChatContainerClass *klass)
         nullptr,
         g_cclosure_marshal_VOID__STRING,
         G_TYPE_NONE, 1, G_TYPE_STRING);
+
+    /* sender avatars are served from avatar_cache() */
+    auto* web_context = webkit_web_context_get_default();
+    webkit_web_context_register_uri_scheme(web_context, "ring-avatar",
+                                           avatar_uri_scheme_request, nullptr, nullptr);
+    webkit_security_manager_register_uri_scheme_as_local(
+        webkit_web_context_get_security_manager(web_context), "ring-avatar");
+
+    /* previews of transferred images */
+    webkit_web_context_register_uri_scheme(web_context, "ring-thumb",
+                                           thumbnail_uri_scheme_request, nullptr, nullptr);
+    webkit_security_manager_register_uri_scheme_as_local(
+        webkit_web_context_get_security_manager(web_context), "ring-thumb");
+
+    /* bound the thumbnails cached by the previous sessions */
+    auto* task = g_task_new(nullptr, nullptr, nullptr, nullptr);
+    g_task_run_in_thread(task, prune_thumbnail_cache);
+    g_object_unref(task);
 }
 
 static gboolean
@@ -156,10 +666,53 @@ webview_chat_context_menu(G_GNUC_UNUSED WebKitChatContainer *self,
     return FALSE;
 }
 
+static gboolean
+flush_interaction_delta(WebKitChatContainer *view)
+{
+    WebKitChatContainerPrivate *priv = WEBKIT_CHAT_CONTAINER_GET_PRIVATE(view);
+    priv->flush_delta_source = 0;
+
+    if (priv->pending_delta->empty() || !priv->webview_chat)
+        return G_SOURCE_REMOVE;
+
+    auto& writer = *priv->delta_writer;
+    writer.clear();
+    writer.raw("applyInteractionDelta(");
+    priv->pending_delta->takeJson(writer);
+    writer.raw(");");
+    webkit_web_view_run_javascript(
+        WEBKIT_WEB_VIEW(priv->webview_chat),
+        writer.c_str(),
+        NULL,
+        NULL,
+        NULL
+    );
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+queue_interaction_delta(WebKitChatContainer *view)
+{
+    WebKitChatContainerPrivate *priv = WEBKIT_CHAT_CONTAINER_GET_PRIVATE(view);
+    if (!priv->flush_delta_source)
+        priv->flush_delta_source = g_idle_add_full(G_PRIORITY_DEFAULT,
+                                                   (GSourceFunc)flush_interaction_delta,
+                                                   view,
+                                                   NULL);
+}
+
 static void
 webkit_chat_container_execute_js(WebKitChatContainer *view, const gchar* function_call)
 {
     WebKitChatContainerPrivate *priv = WEBKIT_CHAT_CONTAINER_GET_PRIVATE(view);
+
+    /* pending interaction changes must be applied before anything else */
+    if (priv->flush_delta_source) {
+        g_source_remove(priv->flush_delta_source);
+        flush_interaction_delta(view);
+    }
+
     webkit_web_view_run_javascript(
         WEBKIT_WEB_VIEW(priv->webview_chat),
         function_call,
@@ -169,119 +722,154 @@ webkit_chat_container_execute_js(WebKitChatContainer *view, const gchar* functio
     );
 }
 
-QJsonObject
-build_interaction_json(lrc::api::ConversationModel& conversation_model,
-                       const uint64_t msgId,
-                       const lrc::api::interaction::Info& interaction)
+static constexpr JsonLiteral
+interaction_type_json(lrc::api::interaction::Type type)
 {
-    auto sender = QString(interaction.authorUri.c_str());
-    auto timestamp = QString::number(interaction.timestamp);
-    auto direction = lrc::api::interaction::isOutgoing(interaction) ? QString("out") : QString("in");
-
-    QJsonObject interaction_object = QJsonObject();
-    interaction_object.insert("text", QJsonValue(QString(interaction.body.c_str())));
-    interaction_object.insert("id", QJsonValue(QString::number(msgId)));
-    interaction_object.insert("sender", QJsonValue(sender));
-    interaction_object.insert("sender_contact_method", QJsonValue(sender));
-    interaction_object.insert("timestamp", QJsonValue(timestamp));
-    interaction_object.insert("direction", QJsonValue(direction));
-
-    switch (interaction.type)
+    switch (type)
     {
     case lrc::api::interaction::Type::TEXT:
-        interaction_object.insert("type", QJsonValue("text"));
-        break;
+        return "text";
     case lrc::api::interaction::Type::CALL:
-        interaction_object.insert("type", QJsonValue("call"));
-        break;
+        return "call";
     case lrc::api::interaction::Type::CONTACT:
-        interaction_object.insert("type", QJsonValue("contact"));
-        break;
+        return "contact";
     case lrc::api::interaction::Type::OUTGOING_DATA_TRANSFER:
-    case lrc::api::interaction::Type::INCOMING_DATA_TRANSFER: {
-        interaction_object.insert("type", QJsonValue("data_transfer"));
-        lrc::api::datatransfer::Info info = {};
-        conversation_model.getTransferInfo(msgId, info);
-        if (info.status != lrc::api::datatransfer::Status::INVALID) {
-            interaction_object.insert("totalSize", QJsonValue(qint64(info.totalSize)));
-            interaction_object.insert("progress", QJsonValue(qint64(info.progress)));
-        }
-        break;
-    }
+    case lrc::api::interaction::Type::INCOMING_DATA_TRANSFER:
+        return "data_transfer";
     case lrc::api::interaction::Type::INVALID:
     default:
-        interaction_object.insert("type", QJsonValue(""));
-        break;
+        return "";
     }
+}
 
-    switch (interaction.status)
+static constexpr JsonLiteral
+delivery_status_json(lrc::api::interaction::Status status)
+{
+    switch (status)
     {
     case lrc::api::interaction::Status::READ:
-        interaction_object.insert("delivery_status", QJsonValue("read"));
-        break;
+        return "read";
     case lrc::api::interaction::Status::SUCCEED:
-        interaction_object.insert("delivery_status", QJsonValue("sent"));
-        break;
+        return "sent";
     case lrc::api::interaction::Status::FAILED:
     case lrc::api::interaction::Status::TRANSFER_ERROR:
-        interaction_object.insert("delivery_status", QJsonValue("failure"));
-        break;
+        return "failure";
     case lrc::api::interaction::Status::TRANSFER_UNJOINABLE_PEER:
-        interaction_object.insert("delivery_status", QJsonValue("unjoinable peer"));
-        break;
+        return "unjoinable peer";
     case lrc::api::interaction::Status::SENDING:
-        interaction_object.insert("delivery_status", QJsonValue("sending"));
-        break;
+        return "sending";
     case lrc::api::interaction::Status::TRANSFER_CREATED:
-        interaction_object.insert("delivery_status", QJsonValue("connecting"));
-        break;
+        return "connecting";
     case lrc::api::interaction::Status::TRANSFER_ACCEPTED:
-        interaction_object.insert("delivery_status", QJsonValue("accepted"));
-        break;
+        return "accepted";
     case lrc::api::interaction::Status::TRANSFER_CANCELED:
-        interaction_object.insert("delivery_status", QJsonValue("canceled"));
-        break;
+        return "canceled";
     case lrc::api::interaction::Status::TRANSFER_ONGOING:
-        interaction_object.insert("delivery_status", QJsonValue("ongoing"));
-        break;
+        return "ongoing";
     case lrc::api::interaction::Status::TRANSFER_AWAITING_PEER:
-        interaction_object.insert("delivery_status", QJsonValue("awaiting peer"));
-        break;
+        return "awaiting peer";
     case lrc::api::interaction::Status::TRANSFER_AWAITING_HOST:
-        interaction_object.insert("delivery_status", QJsonValue("awaiting host"));
-        break;
+        return "awaiting host";
     case lrc::api::interaction::Status::TRANSFER_TIMEOUT_EXPIRED:
-        interaction_object.insert("delivery_status", QJsonValue("awaiting peer timeout"));
-        break;
+        return "awaiting peer timeout";
     case lrc::api::interaction::Status::TRANSFER_FINISHED:
-        interaction_object.insert("delivery_status", QJsonValue("finished"));
-        break;
+        return "finished";
     case lrc::api::interaction::Status::INVALID:
     case lrc::api::interaction::Status::UNKNOWN:
     case lrc::api::interaction::Status::UNREAD:
     default:
-        interaction_object.insert("delivery_status", QJsonValue("unknown"));
-        break;
+        return "unknown";
+    }
+}
+
+static void
+write_interaction_json(JsonWriter& writer,
+                       lrc::api::ConversationModel& conversation_model,
+                       const uint64_t msgId,
+                       const lrc::api::interaction::Info& interaction)
+{
+    writer.beginObject();
+    writer.key("text");
+    writer.value(interaction.body);
+    writer.key("id");
+    writer.valueAsString(static_cast<guint64>(msgId));
+    writer.key("sender");
+    writer.value(interaction.authorUri);
+    writer.key("sender_contact_method");
+    writer.value(interaction.authorUri);
+    writer.key("timestamp");
+    writer.valueAsString(interaction.timestamp);
+    writer.key("direction");
+    writer.literal(lrc::api::interaction::isOutgoing(interaction) ? JsonLiteral("out") : JsonLiteral("in"));
+    writer.key("type");
+    writer.literal(interaction_type_json(interaction.type));
+
+    if (interaction.type == lrc::api::interaction::Type::OUTGOING_DATA_TRANSFER
+        || interaction.type == lrc::api::interaction::Type::INCOMING_DATA_TRANSFER) {
+        lrc::api::datatransfer::Info info = {};
+        conversation_model.getTransferInfo(msgId, info);
+        if (info.status != lrc::api::datatransfer::Status::INVALID) {
+            writer.key("totalSize");
+            writer.value(static_cast<gint64>(info.totalSize));
+            writer.key("progress");
+            writer.value(static_cast<gint64>(info.progress));
+        }
     }
-    return interaction_object;
+
+    writer.key("delivery_status");
+    writer.literal(delivery_status_json(interaction.status));
+    writer.endObject();
 }
 
-QString
-interaction_to_json_interaction_object(lrc::api::ConversationModel& conversation_model,
-                                       const uint64_t msgId,
-                                       const lrc::api::interaction::Info& interaction)
+/**
+ * Serialize a single interaction into the reusable buffer of the container.
+ * The returned string is only valid until the buffer is used again.
+ */
+static const std::string&
+interaction_to_json(WebKitChatContainer *view,
+                    lrc::api::ConversationModel& conversation_model,
+                    const uint64_t msgId,
+                    const lrc::api::interaction::Info& interaction)
 {
-    auto interaction_object = build_interaction_json(conversation_model, msgId, interaction);
-    return QString(QJsonDocument(interaction_object).toJson(QJsonDocument::Compact));
+    WebKitChatContainerPrivate *priv = WEBKIT_CHAT_CONTAINER_GET_PRIVATE(view);
+    priv->json_writer->clear();
+    write_interaction_json(*priv->json_writer, conversation_model, msgId, interaction);
+    return priv->json_writer->str();
 }
 
-QString
-interactions_to_json_array_object(lrc::api::ConversationModel& conversation_model,
-                                  const std::map<uint64_t, lrc::api::interaction::Info> interactions) {
-    QJsonArray array;
-    for (const auto& interaction: interactions)
-        array.append(build_interaction_json(conversation_model, interaction.first, interaction.second));
-    return QString(QJsonDocument(array).toJson(QJsonDocument::Compact));
+/* number of interactions sent to the chatview at once, older ones are
+ * requested by the chatview page by page when the user scrolls up */
+static constexpr std::size_t HISTORY_PAGE_SIZE = 100;
+
+/**
+ * Call function with the HISTORY_PAGE_SIZE interactions preceding end, oldest
+ * first, and whether there are older interactions than these.
+ */
+static void
+print_interactions_page(WebKitChatContainer *view,
+                        JsonLiteral function,
+                        lrc::api::ConversationModel& conversation_model,
+                        const std::map<uint64_t, lrc::api::interaction::Info>& interactions,
+                        std::map<uint64_t, lrc::api::interaction::Info>::const_iterator end)
+{
+    WebKitChatContainerPrivate *priv = WEBKIT_CHAT_CONTAINER_GET_PRIVATE(view);
+
+    auto begin = end;
+    for (std::size_t i = 0; i < HISTORY_PAGE_SIZE && begin != interactions.begin(); ++i)
+        --begin;
+
+    auto& writer = *priv->json_writer;
+    writer.clear();
+    writer.raw(function);
+    writer.raw("(");
+    writer.beginArray();
+    for (auto it = begin; it != end; ++it)
+        write_interaction_json(writer, conversation_model, it->first, it->second);
+    writer.endArray();
+    writer.boolean(begin != interactions.begin());
+    writer.raw(");");
+
+    webkit_chat_container_execute_js(view, writer.c_str());
 }
 
 #if WEBKIT_CHECK_VERSION(2, 6, 0)
@@ -349,74 +937,89 @@ webview_script_dialog(WebKitWebView      *self,
     return true;
 }
 
-static void
-javascript_library_loaded(WebKitWebView *webview_chat,
-                          GAsyncResult *result,
-                          WebKitChatContainer* self)
+/**
+ * The javascript libraries used by chatview.html, bundled in a single user
+ * script which is injected before the page is parsed. It is built once and
+ * reused when the web view is rebuilt.
+ */
+static WebKitUserScript*
+chatview_libraries_script()
 {
-    g_return_if_fail(IS_WEBKIT_CHAT_CONTAINER(self));
-    WebKitChatContainerPrivate *priv = WEBKIT_CHAT_CONTAINER_GET_PRIVATE(self);
+    static WebKitUserScript* script = nullptr;
+    if (script)
+        return script;
+
+    static const gchar* libraries[] = {
+        "/cx/ring/RingGnome/linkify.js",
+        "/cx/ring/RingGnome/linkify-string.js",
+        "/cx/ring/RingGnome/linkify-html.js",
+    };
+
+    GString* source = g_string_new(nullptr);
+    for (auto* library : libraries) {
+        GError *error = nullptr;
+        auto* bytes = g_resources_lookup_data(library, G_RESOURCE_LOOKUP_FLAGS_NONE, &error);
+        if (!bytes) {
+            g_warning("Error loading %s: %s", library, error->message);
+            g_error_free(error);
+            continue;
+        }
+        g_string_append_len(source, (const gchar*) g_bytes_get_data(bytes, nullptr), g_bytes_get_size(bytes));
+        g_string_append(source, "\n;\n");
+        g_bytes_unref(bytes);
+    }
 
-    auto loaded_library = g_list_first(priv->js_libs_to_load);
+    script = webkit_user_script_new(
+        source->str,
+        WEBKIT_USER_CONTENT_INJECT_TOP_FRAME,
+        WEBKIT_USER_SCRIPT_INJECT_AT_DOCUMENT_START,
+        NULL,
+        NULL
+    );
+    g_string_free(source, TRUE);
 
-    GError *error = NULL;
-    WebKitJavascriptResult* js_result = webkit_web_view_run_javascript_from_gresource_finish(webview_chat, result, &error);
-    if (!js_result) {
-        g_warning("Error loading %s: %s", (const gchar*) loaded_library->data, error->message);
-        g_error_free(error);
-        g_object_unref(self);
-        /* Stop loading view, most likely resulting in a blank page */
-        return;
-    }
-    webkit_javascript_result_unref(js_result);
+    return script;
+}
 
-    priv->js_libs_to_load = g_list_remove(priv->js_libs_to_load, loaded_library->data);
+static WebKitUserStyleSheet*
+chatview_style_sheet()
+{
+    static WebKitUserStyleSheet* style_sheet = nullptr;
+    if (style_sheet)
+        return style_sheet;
 
-    if(g_list_length(priv->js_libs_to_load) > 0)
-    {
-        /* keep loading... */
-        webkit_web_view_run_javascript_from_gresource(
-            webview_chat,
-            (const gchar*) g_list_first(priv->js_libs_to_load)->data,
-            NULL,
-            (GAsyncReadyCallback) javascript_library_loaded,
-            self
-        );
-    }
-    else
-    {
-         priv->js_libs_loaded = TRUE;
-         g_signal_emit(G_OBJECT(self), webkit_chat_container_signals[READY], 0);
+    auto* bytes = g_resources_lookup_data("/cx/ring/RingGnome/chatview.css", G_RESOURCE_LOOKUP_FLAGS_NONE, NULL);
+    style_sheet = webkit_user_style_sheet_new(
+        (gchar*) g_bytes_get_data(bytes, NULL),
+        WEBKIT_USER_CONTENT_INJECT_ALL_FRAMES,
+        WEBKIT_USER_STYLE_LEVEL_USER,
+        NULL,
+        NULL
+    );
+    g_bytes_unref(bytes);
 
-         /* The view could now be deleted without causing a crash */
-         g_object_unref(self);
-    }
+    return style_sheet;
 }
 
 static void
-load_javascript_libs(WebKitWebView *webview_chat,
-                     WebKitChatContainer* self)
+webview_chat_loaded(WebKitChatContainer* self)
 {
     WebKitChatContainerPrivate *priv = WEBKIT_CHAT_CONTAINER_GET_PRIVATE(self);
 
-    /* Create the list of libraries to load */
-    priv->js_libs_to_load = g_list_append(priv->js_libs_to_load, (gchar*) "/cx/ring/RingGnome/linkify.js");
-    priv->js_libs_to_load = g_list_append(priv->js_libs_to_load, (gchar*) "/cx/ring/RingGnome/linkify-string.js");
-    priv->js_libs_to_load = g_list_append(priv->js_libs_to_load, (gchar*) "/cx/ring/RingGnome/linkify-html.js");
+    /* the replacement of a crashed web view is only displayed once loaded */
+    if (priv->crashed_webview_chat) {
+        gtk_widget_destroy(priv->crashed_webview_chat);
+        priv->crashed_webview_chat = nullptr;
+        gtk_widget_show(priv->webview_chat);
+    }
 
-    /* ref the chat view so that its not destroyed while we load
-     * we will unref in javascript_library_loaded
-     */
-    g_object_ref(self);
+    priv->page_loaded = TRUE;
 
-   /* start loading */
-    webkit_web_view_run_javascript_from_gresource(
-        WEBKIT_WEB_VIEW(webview_chat),
-        (const gchar*) g_list_first(priv->js_libs_to_load)->data,
-        NULL,
-        (GAsyncReadyCallback) javascript_library_loaded,
-        self
-    );
+    if (priv->header_hidden)
+        webkit_chat_set_header_visible(self, false);
+
+    /* the views using the container display their conversation again */
+    g_signal_emit(G_OBJECT(self), webkit_chat_container_signals[READY], 0);
 }
 
 static void
@@ -436,7 +1039,7 @@ webview_chat_load_changed(WebKitWebView  *webview_chat,
         }
         case WEBKIT_LOAD_FINISHED:
         {
-            load_javascript_libs(webview_chat, self);
+            webview_chat_loaded(self);
             //TODO: disconnect? It shouldn't happen more than once
             break;
         }
@@ -491,22 +1094,8 @@ build_view(WebKitChatContainer *view)
 
     /* Prepare WebKitUserContentManager */
     WebKitUserContentManager* webkit_content_manager = webkit_user_content_manager_new();
-
-    WebKitUserStyleSheet* chatview_style_sheet = webkit_user_style_sheet_new(
-        (gchar*) g_bytes_get_data(
-            g_resources_lookup_data(
-                "/cx/ring/RingGnome/chatview.css",
-                G_RESOURCE_LOOKUP_FLAGS_NONE,
-                NULL
-            ),
-            NULL
-        ),
-        WEBKIT_USER_CONTENT_INJECT_ALL_FRAMES,
-        WEBKIT_USER_STYLE_LEVEL_USER,
-        NULL,
-        NULL
-    );
-    webkit_user_content_manager_add_style_sheet(webkit_content_manager, chatview_style_sheet);
+    webkit_user_content_manager_add_style_sheet(webkit_content_manager, chatview_style_sheet());
+    webkit_user_content_manager_add_script(webkit_content_manager, chatview_libraries_script());
 
     /* Prepare WebKitSettings */
     WebKitSettings* webkit_settings = webkit_settings_new_with_settings(
@@ -526,8 +1115,11 @@ build_view(WebKitChatContainer *view)
         )
     );
 
+    g_object_unref(webkit_content_manager);
+
     gtk_container_add(GTK_CONTAINER(priv->box_webview_chat), priv->webview_chat);
-    gtk_widget_show(priv->webview_chat);
+    if (!priv->crashed_webview_chat)
+        gtk_widget_show(priv->webview_chat);
     gtk_widget_set_vexpand(GTK_WIDGET(priv->webview_chat), TRUE);
     gtk_widget_set_hexpand(GTK_WIDGET(priv->webview_chat), TRUE);
 
@@ -555,9 +1147,10 @@ build_view(WebKitChatContainer *view)
         (gchar*) g_bytes_get_data(chatview_bytes, NULL),
         "file://"
     );
+    g_bytes_unref(chatview_bytes);
 
-    /* Now we wait for the load-changed event, before we
-     * start loading javascript libraries */
+    /* Now we wait for the load-changed event, the javascript libraries are
+     * loaded with the page */
 
     /* handle web view crash */
     g_signal_connect_swapped(priv->webview_chat, "web-process-crashed", G_CALLBACK(webview_crashed), view);
@@ -570,11 +1163,22 @@ webview_crashed(WebKitChatContainer *self)
 
     auto priv = WEBKIT_CHAT_CONTAINER_GET_PRIVATE(self);
 
-    /* make sure we destroy previous WebView */
-    if (priv->webview_chat) {
-        gtk_widget_destroy(priv->webview_chat);
-        priv->webview_chat = nullptr;
+    priv->page_loaded = FALSE;
+
+    /* the pending changes were for the crashed page, the views display their
+     * conversation again once the new page is loaded */
+    if (priv->flush_delta_source) {
+        g_source_remove(priv->flush_delta_source);
+        priv->flush_delta_source = 0;
     }
+    priv->pending_delta->clear();
+
+    /* keep the crashed WebView displayed until the new one is loaded, instead
+     * of showing an empty page meanwhile */
+    if (priv->crashed_webview_chat)
+        gtk_widget_destroy(priv->crashed_webview_chat);
+    priv->crashed_webview_chat = priv->webview_chat;
+    priv->webview_chat = nullptr;
 
     build_view(self);
 
@@ -587,7 +1191,7 @@ webkit_chat_container_new()
     gpointer view = g_object_new(WEBKIT_CHAT_CONTAINER_TYPE, NULL);
 
     WebKitChatContainerPrivate *priv = WEBKIT_CHAT_CONTAINER_GET_PRIVATE(view);
-    priv->js_libs_loaded = FALSE;
+    priv->page_loaded = FALSE;
 
     build_view(WEBKIT_CHAT_CONTAINER(view));
 
@@ -620,6 +1224,10 @@ webkit_chat_container_clear_sender_images(WebKitChatContainer *view)
 void
 webkit_chat_container_clear(WebKitChatContainer *view)
 {
+    /* the pending changes were for the messages being cleared */
+    WebKitChatContainerPrivate *priv = WEBKIT_CHAT_CONTAINER_GET_PRIVATE(view);
+    priv->pending_delta->clear();
+
     webkit_chat_container_execute_js(view, "clearMessages();");
     webkit_chat_container_clear_sender_images(view);
 }
@@ -630,18 +1238,17 @@ webkit_chat_container_update_interaction(WebKitChatContainer *view,
                                          uint64_t msgId,
                                          const lrc::api::interaction::Info& interaction)
 {
-    auto interaction_object = interaction_to_json_interaction_object(conversation_model, msgId, interaction).toUtf8();
-    gchar* function_call = g_strdup_printf("updateMessage(%s);", interaction_object.constData());
-    webkit_chat_container_execute_js(view, function_call);
-    g_free(function_call);
+    WebKitChatContainerPrivate *priv = WEBKIT_CHAT_CONTAINER_GET_PRIVATE(view);
+    priv->pending_delta->update(msgId, interaction_to_json(view, conversation_model, msgId, interaction));
+    queue_interaction_delta(view);
 }
 
 void
 webkit_chat_container_remove_interaction(WebKitChatContainer *view, uint64_t interactionId)
 {
-    gchar* function_call = g_strdup_printf("removeInteraction(%lu);", interactionId);
-    webkit_chat_container_execute_js(view, function_call);
-    g_free(function_call);
+    WebKitChatContainerPrivate *priv = WEBKIT_CHAT_CONTAINER_GET_PRIVATE(view);
+    priv->pending_delta->remove(interactionId);
+    queue_interaction_delta(view);
 }
 
 
@@ -651,21 +1258,27 @@ webkit_chat_container_print_new_interaction(WebKitChatContainer *view,
                                             uint64_t msgId,
                                             const lrc::api::interaction::Info& interaction)
 {
-    auto interaction_object = interaction_to_json_interaction_object(conversation_model, msgId, interaction).toUtf8();
-    gchar* function_call = g_strdup_printf("addMessage(%s);", interaction_object.constData());
-    webkit_chat_container_execute_js(view, function_call);
-    g_free(function_call);
+    WebKitChatContainerPrivate *priv = WEBKIT_CHAT_CONTAINER_GET_PRIVATE(view);
+    priv->pending_delta->add(msgId, interaction_to_json(view, conversation_model, msgId, interaction));
+    queue_interaction_delta(view);
 }
 
 void
 webkit_chat_container_print_history(WebKitChatContainer *view,
                                     lrc::api::ConversationModel& conversation_model,
-                                    const std::map<uint64_t, lrc::api::interaction::Info> interactions)
+                                    const std::map<uint64_t, lrc::api::interaction::Info>& interactions)
 {
-    auto interactions_str = interactions_to_json_array_object(conversation_model, interactions).toUtf8();
-    gchar* function_call = g_strdup_printf("printHistory(%s)", interactions_str.constData());
-    webkit_chat_container_execute_js(view, function_call);
-    g_free(function_call);
+    print_interactions_page(view, "printHistory", conversation_model, interactions, interactions.cend());
+}
+
+void
+webkit_chat_container_print_history_page(WebKitChatContainer *view,
+                                         lrc::api::ConversationModel& conversation_model,
+                                         const std::map<uint64_t, lrc::api::interaction::Info>& interactions,
+                                         uint64_t before)
+{
+    print_interactions_page(view, "printHistoryPage", conversation_model, interactions,
+                            interactions.lower_bound(before));
 }
 
 void
@@ -683,27 +1296,33 @@ webkit_chat_container_set_sender_image(WebKitChatContainer *view, const std::str
 {
     WebKitChatContainerPrivate *priv = WEBKIT_CHAT_CONTAINER_GET_PRIVATE(view);
 
-    QJsonObject set_sender_image_object = QJsonObject();
-    set_sender_image_object.insert("sender_contact_method", QJsonValue(QString(sender.c_str())));
-    set_sender_image_object.insert("sender_image", QJsonValue(QString(senderImage.c_str())));
-
-    auto set_sender_image_object_string = QString(QJsonDocument(set_sender_image_object).toJson(QJsonDocument::Compact));
-
-    gchar* function_call = g_strdup_printf("setSenderImage(%s);", set_sender_image_object_string.toUtf8().constData());
-    webkit_web_view_run_javascript(WEBKIT_WEB_VIEW(priv->webview_chat), function_call, NULL, NULL, NULL);
-    g_free(function_call);
+    auto& writer = *priv->json_writer;
+    writer.clear();
+    writer.raw("setSenderImage(");
+    writer.beginObject();
+    writer.key("sender_contact_method");
+    writer.value(sender);
+    writer.key("sender_image_url");
+    writer.value(avatar_cache().put(sender, senderImage));
+    writer.endObject();
+    writer.raw(");");
+
+    webkit_chat_container_execute_js(view, writer.c_str());
 }
 
 gboolean
 webkit_chat_container_is_ready(WebKitChatContainer *view)
 {
     WebKitChatContainerPrivate *priv = WEBKIT_CHAT_CONTAINER_GET_PRIVATE(view);
-    return priv->js_libs_loaded;
+    return priv->page_loaded;
 }
 
 void
 webkit_chat_set_header_visible(WebKitChatContainer *view, bool isVisible)
 {
+    WebKitChatContainerPrivate *priv = WEBKIT_CHAT_CONTAINER_GET_PRIVATE(view);
+    priv->header_hidden = !isVisible;
+
     gchar* function_call = g_strdup_printf("displayNavbar(%s)", isVisible ? "true" : "false");
     webkit_chat_container_execute_js(view, function_call);
     g_free(function_call);